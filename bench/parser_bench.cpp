@@ -0,0 +1,226 @@
+/* Throughput benchmark and stress suite for the reader.
+ *
+ * Synthetic inputs are generated in memory, then the Tokenizor alone and
+ * the Tokenizor + ASTGenerator::absorb pipeline are timed on each of them,
+ * both on an in-memory buffer (like a mapped file) and through a stream
+ * (block reads). Each run takes place in a process of its own, so the
+ * reported peak RSS is that of the run alone, generated input included.
+ *
+ * Usage: parser_bench [SCALE]
+ * SCALE (default 1) multiplies the size of every generated input.
+ */
+#include "parser.h"
+#include "types.h"
+#include "gc.h"
+#include "exc.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <ctime>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+GarbageCollector gc;
+EmptyList *empty_list = new EmptyList();
+UnspecObj *unspec_obj = new UnspecObj();
+
+/** A generated input and the number of top-level datums in it */
+struct BenchCase {
+    const char *name;
+    string data;
+    size_t datums;
+};
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double peak_rss_mb() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss / 1024.0;   // ru_maxrss is in KiB on Linux
+}
+
+static void gen_deep_nesting(BenchCase &c, size_t scale) {
+    size_t depth = 100000 * scale;
+    if (depth > PARSE_STACK_SIZE / 2) depth = PARSE_STACK_SIZE / 2;
+    c.data.assign(depth, '(');
+    c.data += "leaf";
+    c.data.append(depth, ')');
+    c.data += '\n';
+    c.datums = 1;
+}
+
+static void gen_small_lists(BenchCase &c, size_t scale) {
+    size_t n = 1000000 * scale;
+    std::ostringstream ss;
+    for (size_t i = 0; i < n; i++)
+        ss << "(rec " << i << " \"v\" #t 'sym)\n";
+    c.data = ss.str();
+    c.datums = n;
+}
+
+static void gen_long_strings(BenchCase &c, size_t scale) {
+    size_t n = 64 * scale;
+    string plain(1 << 20, 'x'), escaped;
+    for (size_t i = 0; i < (1 << 18); i++)
+        escaped += "ab\\n";
+    for (size_t i = 0; i < n; i++)
+    {
+        c.data += '"';
+        c.data += (i & 1) ? escaped : plain;
+        c.data += "\"\n";
+    }
+    c.datums = n;
+}
+
+static void gen_big_vector(BenchCase &c, size_t scale) {
+    // two elements per step, all of them sit on the parse stack at once
+    size_t n = 100000 * scale;
+    if (n > PARSE_STACK_SIZE / 4) n = PARSE_STACK_SIZE / 4;
+    std::ostringstream ss;
+    ss << "#(";
+    for (size_t i = 0; i < n; i++)
+        ss << (i % 10 ? "sym " : "\"str\" ") << i << ' ';
+    ss << ")\n";
+    string one = ss.str();
+    // repeat it so that the case runs long enough to be measured
+    for (int k = 0; k < 16; k++)
+        c.data += one;
+    c.datums = 16;
+}
+
+static void gen_numeric(BenchCase &c, size_t scale) {
+    size_t n = 200000 * scale;
+    std::ostringstream ss;
+    for (size_t i = 0; i < n; i++)
+        ss << "(" << i << " -" << i * 7919 << " " << i << ".25 "
+           << i + 1 << "/" << i + 2 << " 1.5e" << i % 300 << " "
+           << "123456789012345678901234567890" << i << ")\n";
+    c.data = ss.str();
+    c.datums = n;
+}
+
+/** Count the tokens only */
+static size_t run_tokenizor(Tokenizor &tk) {
+    TokenView tok;
+    size_t cnt = 0;
+    while (tk.get_token(tok)) cnt++;
+    return cnt;
+}
+
+/** Build and free every datum */
+static size_t run_reader(Tokenizor &tk) {
+    ASTGenerator ast;
+    Pair *tree;
+    size_t cnt = 0;
+    while ((tree = ast.absorb(&tk)))
+    {
+        gc.attach(tree);
+        gc.expose(tree);
+        gc.collect();
+        cnt++;
+    }
+    return cnt;
+}
+
+/** Feed the data through a stream, so the block reading path is used */
+static FILE *make_stream(const string &data) {
+    FILE *f = tmpfile();
+    if (!f || fwrite(data.data(), 1, data.length(), f) != data.length())
+    {
+        perror("tmpfile");
+        exit(1);
+    }
+    rewind(f);
+    return f;
+}
+
+/** Generate the input of `c` and time it in `mode` (stream if set)
+ * @return non-zero if the datums are not all read */
+static int run_case(BenchCase &c, void (*gen)(BenchCase &, size_t),
+                    size_t scale, int mode) {
+    gen(c, scale);
+    double mb = c.data.length() / 1048576.0;
+    Tokenizor tk;
+    FILE *f = NULL;
+    if (mode) tk.set_stream(f = make_stream(c.data));
+    else tk.set_buffer(c.data.data(), c.data.length());
+    double t0 = now();
+    size_t ntok = run_tokenizor(tk);
+    double t1 = now();
+
+    if (mode) { rewind(f); tk.set_stream(f); }
+    else tk.set_buffer(c.data.data(), c.data.length());
+    double t2 = now();
+    size_t ndat = 0;
+    try
+    {
+        ndat = run_reader(tk);
+    }
+    catch (GeneralError &e)
+    {
+        fprintf(stderr, "%s: %s\n", c.name, e.get_msg().c_str());
+    }
+    double t3 = now();
+    if (f) fclose(f);
+
+    printf("%-14s %-6s %9.2f %11lu %9.1f %9.2f %9.1f %12.1f\n",
+            c.name, mode ? "stream" : "memory", mb,
+            (unsigned long)ntok, mb / (t1 - t0),
+            ntok / (t1 - t0) / 1e6, mb / (t3 - t2), peak_rss_mb());
+    if (ndat != c.datums)
+    {
+        fprintf(stderr, "%s: read %lu datums, expecting %lu\n",
+                c.name, (unsigned long)ndat, (unsigned long)c.datums);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    size_t scale = argc > 1 ? strtoul(argv[1], NULL, 10) : 1;
+    if (!scale) scale = 1;
+    gc.attach(empty_list);
+    gc.attach(unspec_obj);
+
+    BenchCase cases[] = {
+        {"deep-nesting", "", 0},
+        {"small-lists", "", 0},
+        {"long-strings", "", 0},
+        {"big-vector", "", 0},
+        {"numeric", "", 0}
+    };
+    void (*gens[])(BenchCase &, size_t) = {
+        gen_deep_nesting, gen_small_lists, gen_long_strings,
+        gen_big_vector, gen_numeric
+    };
+    const size_t ncases = sizeof(cases) / sizeof(cases[0]);
+    int failed = 0;
+
+    printf("%-14s %-6s %9s %11s %9s %9s %9s %12s\n",
+            "case", "input", "size(MB)", "tokens", "tok MB/s",
+            "Mtok/s", "read MB/s", "run peak(MB)");
+    for (size_t i = 0; i < ncases; i++)
+        for (int mode = 0; mode < 2; mode++)
+        {
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                perror("fork");
+                return 1;
+            }
+            if (!pid) exit(run_case(cases[i], gens[i], scale, mode));
+            int status;
+            if (waitpid(pid, &status, 0) < 0 ||
+                    !WIFEXITED(status) || WEXITSTATUS(status))
+                failed = 1;
+        }
+    return failed;
+}
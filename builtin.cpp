@@ -2,10 +2,24 @@
 #include "builtin.h"
 #include "exc.h"
 #include "gc.h"
+#include "port.h"
+#include "parser.h"
+#include "serialize.h"
+#include "hash.h"
+#include "homovec.h"
+#include "strsearch.h"
+#include "record.h"
 
 #include <cstdio>
+#include <cstring>
 #include <cctype>
 #include <cstdlib>
+#include <climits>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include <fcntl.h>
 
 using std::stringstream;
 
@@ -262,6 +276,115 @@ Pair *SpecialOptDefine::call(Pair *args, Environment * &lenvt,
     return ret_addr->next;
 }
 
+SpecialOptDefineRecord::SpecialOptDefineRecord() :
+    SpecialOptObj("define-record-type") {}
+
+void SpecialOptDefineRecord::prepare(Pair *pc) {
+    // (define-record-type <name> <constructor> <predicate> <field>...)
+    Pair *ptr = pc;
+    for (int i = 0; i < 3; i++)
+    {
+        if (ptr->cdr == empty_list) EXC_WRONG_ARG_NUM;
+        ptr = TO_PAIR(ptr->cdr);
+    }
+    pc->next = NULL;
+}
+
+/** Get the symbols in `spec`, a non-empty list in the definition of a
+ * record type */
+static void record_syms(EvalObj *spec, std::vector<SymObj*> &syms) {
+    EvalObj *ptr = spec;
+    for (; ptr->is_pair_obj() && ptr != empty_list; ptr = TO_PAIR(ptr)->cdr)
+    {
+        CHECK_SYMBOL(TO_PAIR(ptr)->car);
+        syms.push_back(static_cast<SymObj*>(TO_PAIR(ptr)->car));
+    }
+    if (ptr != empty_list || syms.empty())
+        throw TokenError(spec->ext_repr(), SYN_ERR_BAD_FORMAL);
+}
+
+Pair *SpecialOptDefineRecord::call(Pair *args, Environment * &lenvt,
+        Continuation * &cont, EvalObj ** &top_ptr, Pair *pc) {
+    Pair *ret_addr = cont->pc;
+    Pair *spec = TO_PAIR(pc->cdr);
+    EvalObj *type_name = spec->car;
+    spec = TO_PAIR(spec->cdr);
+    EvalObj *ctor = spec->car;
+    spec = TO_PAIR(spec->cdr);
+    EvalObj *pred = spec->car;
+    CHECK_SYMBOL(type_name);
+    if (pred->is_true()) CHECK_SYMBOL(pred);
+
+    // the slots are numbered in the order of the fields
+    std::vector<std::vector<SymObj*> > field_specs;
+    std::vector<string> fields;
+    EvalObj *ptr = spec->cdr;
+    for (; ptr->is_pair_obj() && ptr != empty_list; ptr = TO_PAIR(ptr)->cdr)
+    {
+        EvalObj *field = TO_PAIR(ptr)->car;
+        field_specs.push_back(std::vector<SymObj*>());
+        std::vector<SymObj*> &syms = field_specs.back();
+        record_syms(field, syms);
+        if (syms.size() > 3 ||
+                std::find(fields.begin(), fields.end(),
+                            syms[0]->val) != fields.end())
+            throw TokenError(field->ext_repr(), SYN_ERR_BAD_FORMAL);
+        fields.push_back(syms[0]->val);
+    }
+    if (ptr != empty_list)
+        throw TokenError(name, SYN_ERR_MISS_OR_EXTRA_EXP);
+
+    // a bare constructor name takes all fields
+    SymObj *ctor_id = NULL;
+    std::vector<size_t> inits;
+    if (ctor->is_sym_obj())
+    {
+        ctor_id = static_cast<SymObj*>(ctor);
+        for (size_t i = 0; i < fields.size(); i++)
+            inits.push_back(i);
+    }
+    else if (ctor->is_true())
+    {
+        std::vector<SymObj*> syms;
+        record_syms(ctor, syms);
+        ctor_id = syms[0];
+        for (size_t i = 1; i < syms.size(); i++)
+        {
+            size_t idx = std::find(fields.begin(), fields.end(),
+                                    syms[i]->val) - fields.begin();
+            if (idx == fields.size() ||
+                    std::find(inits.begin(), inits.end(), idx) != inits.end())
+                throw TokenError(ctor->ext_repr(), SYN_ERR_BAD_FORMAL);
+            inits.push_back(idx);
+        }
+    }
+
+    SymObj *type_id = static_cast<SymObj*>(type_name);
+    RecordTypeObj *type = new RecordTypeObj(type_id->val, fields);
+    lenvt->add_binding(type_id, type);
+    if (ctor_id)
+        lenvt->add_binding(ctor_id,
+                new RecordOptObj(type, ctor_id->val, inits));
+    if (pred->is_true())
+        lenvt->add_binding(static_cast<SymObj*>(pred),
+                new RecordOptObj(RECORD_PREDICATE, type,
+                                static_cast<SymObj*>(pred)->val));
+    for (size_t i = 0; i < field_specs.size(); i++)
+    {
+        std::vector<SymObj*> &syms = field_specs[i];
+        if (syms.size() > 1)
+            lenvt->add_binding(syms[1],
+                    new RecordOptObj(RECORD_ACCESSOR, type, syms[1]->val, i));
+        if (syms.size() > 2)
+            lenvt->add_binding(syms[2],
+                    new RecordOptObj(RECORD_MODIFIER, type, syms[2]->val, i));
+    }
+    gc.expose(*top_ptr);
+    *top_ptr++ = gc.attach(unspec_obj);
+    EXIT_CURRENT_EXEC(lenvt, cont, args);
+    return ret_addr->next;
+}
+
 SpecialOptSet::SpecialOptSet() : SpecialOptObj("set!") {}
 
 void SpecialOptSet::prepare(Pair *pc) {
@@ -617,6 +740,592 @@ Pair *SpecialOptDelay::call(Pair *args, Environment * &lenvt,
     return ret_addr->next;          // Move to the next instruction
 }
 
+SpecialOptCaller::SpecialOptCaller(string name) : SpecialOptObj(name) {}
+
+/** Make an expression evaluated to `obj` */
+static EvalObj *quote_obj(EvalObj *obj) {
+    static SpecialOptQuote *quote_opt =
+        static_cast<SpecialOptQuote*>(gc.attach(new SpecialOptQuote()));
+    if (obj->is_simple_obj() && !obj->is_sym_obj())
+        return obj;                     // self-evaluating
+    return new Pair(quote_opt, new Pair(obj, empty_list));
+}
+
+Pair *SpecialOptCaller::call(Pair *_args, Environment * &lenvt,
+        Continuation * &cont, EvalObj ** &top_ptr, Pair *pc) {
+    Pair *ret_addr = cont->pc;
+    EvalObjVec state, keep, next;
+    EvalObj *res = NULL;
+    for (Pair *args = TO_PAIR(_args->cdr);
+            args != empty_list; args = TO_PAIR(args->cdr))
+        state.push_back(args->car);
+    if (cont->state)
+    {
+        // the kept state is followed by the call and its result
+        res = state.back();
+        state.resize(state.size() - 2);
+    }
+    EvalObj *ret = step(state, res, keep, next);
+    if (ret)
+    {
+        gc.expose(*top_ptr);
+        *top_ptr++ = gc.attach(ret);
+        EXIT_CURRENT_EXEC(lenvt, cont, _args);
+        return ret_addr->next;
+    }
+    // build the call, whose arguments are not evaluated again
+    Pair *exp = empty_list;
+    for (size_t i = next.size() - 1; i > 0; i--)
+        exp = new Pair(quote_obj(next[i]), exp);
+    Pair *nexp = new Pair(new Pair(next[0], exp), empty_list);
+    nexp->next = NULL;
+    // restore the stack, as the call is made as if it were an argument
+    top_ptr++;
+    *top_ptr++ = gc.attach(this);
+    for (EvalObjVec::iterator it = keep.begin(); it != keep.end(); it++)
+        *top_ptr++ = gc.attach(*it);
+    *top_ptr++ = gc.attach(nexp);
+    cont->state = nexp;
+    gc.expose(_args);
+    return nexp;
+}
+
+SpecialOptHashUpdate::SpecialOptHashUpdate(bool _def_val) :
+    SpecialOptCaller(_def_val ? "hash-table-update!/default" :
+                                "hash-table-update!"), def_val(_def_val) {}
+
+EvalObj *SpecialOptHashUpdate::step(EvalObjVec &state, EvalObj *res,
+        EvalObjVec &keep, EvalObjVec &call) {
+    if (!res)
+    {
+        if (state.size() < 3 || state.size() > 4 ||
+                (def_val && state.size() != 4))
+            EXC_WRONG_ARG_NUM;
+        if (!(state[0]->get_otype() & CLS_HASH_OBJ))
+            throw TokenError("a hash table", RUN_ERR_WRONG_TYPE);
+        if (!state[2]->is_opt_obj())
+            throw TokenError("an operator", RUN_ERR_WRONG_TYPE);
+        HashTableObj *ht = static_cast<HashTableObj*>(state[0]);
+        EvalObj *val = ht->get(state[1]);
+        if (!val && def_val)
+            val = state[3];
+        if (!val)
+        {
+            if (state.size() == 3)
+                throw NormalError(RUN_ERR_KEY_NOT_FOUND);
+            // get the default value from the thunk first
+            keep.assign(state.begin(), state.end());
+            call.push_back(state[3]);
+            return NULL;
+        }
+        res = val;
+    }
+    else if (state.size() == 2)
+    {
+        static_cast<HashTableObj*>(state[0])->set(state[1], res);
+        return unspec_obj;
+    }
+    // call the procedure with the old value
+    keep.push_back(state[0]);
+    keep.push_back(state[1]);
+    call.push_back(state[2]);
+    call.push_back(res);
+    return NULL;
+}
+
+SpecialOptHashFold::SpecialOptHashFold(bool _walk) :
+    SpecialOptCaller(_walk ? "hash-table-walk" : "hash-table-fold"),
+    walk(_walk) {}
+
+EvalObj *SpecialOptHashFold::step(EvalObjVec &state, EvalObj *res,
+        EvalObjVec &keep, EvalObjVec &call) {
+    VecObj *snap;
+    size_t idx;
+    if (!res)
+    {
+        if (state.size() != (walk ? 2 : 3)) EXC_WRONG_ARG_NUM;
+        if (!(state[0]->get_otype() & CLS_HASH_OBJ))
+            throw TokenError("a hash table", RUN_ERR_WRONG_TYPE);
+        if (!state[1]->is_opt_obj())
+            throw TokenError("an operator", RUN_ERR_WRONG_TYPE);
+        // visit a snapshot, so the procedure may change the table
+        EvalObjVec keys, vals;
+        static_cast<HashTableObj*>(state[0])->get_entries(keys, vals);
+        snap = new VecObj();
+        snap->vec.reserve(keys.size() * 2);
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            snap->push_back(keys[i]);
+            snap->push_back(vals[i]);
+        }
+        idx = 0;
+        res = walk ? unspec_obj : state[2];
+    }
+    else
+    {
+        snap = static_cast<VecObj*>(state[0]);
+        idx = static_cast<IntNumObj*>(state[2])->get_i();
+        if (walk) res = unspec_obj;
+    }
+    if (idx == snap->get_size())
+    {
+        if (state[0] != snap) delete snap;  // never used
+        return res;
+    }
+    keep.push_back(snap);
+    keep.push_back(state[1]);
+    keep.push_back(new IntNumObj(idx + 2));
+    call.push_back(state[1]);
+    call.push_back(snap->get(idx));
+    call.push_back(snap->get(idx + 1));
+    if (!walk) call.push_back(res);
+    return NULL;
+}
+
+/** Make a new list of the elements of `lst` in reverse order, followed by
+ * `tail` */
+static EvalObj *reverse_onto(EvalObj *lst, EvalObj *tail) {
+    for (; lst != empty_list; lst = TO_PAIR(lst)->cdr)
+        tail = new Pair(TO_PAIR(lst)->car, tail);
+    return tail;
+}
+
+/** Check that the operands from `st` in `state` are lists (or the rest of
+ * lists), and test if any of them is exhausted */
+static bool lists_exhausted(EvalObjVec &state, size_t st) {
+    bool res = false;
+    for (size_t i = st; i < state.size(); i++)
+        if (state[i] == empty_list) res = true;
+        else if (!state[i]->is_pair_obj())
+            throw TokenError("a list", RUN_ERR_WRONG_TYPE);
+    return res;
+}
+
+/** Put the car of each list from `st` in `state` to `call`, and its cdr to
+ * `keep` */
+static void lists_advance(EvalObjVec &state, size_t st,
+                        EvalObjVec &keep, EvalObjVec &call) {
+    for (size_t i = st; i < state.size(); i++)
+    {
+        call.push_back(TO_PAIR(state[i])->car);
+        keep.push_back(TO_PAIR(state[i])->cdr);
+    }
+}
+
+SpecialOptMap::SpecialOptMap(bool _for_each) :
+    SpecialOptCaller(_for_each ? "for-each" : "map"), for_each(_for_each) {}
+
+EvalObj *SpecialOptMap::step(EvalObjVec &state, EvalObj *res,
+        EvalObjVec &keep, EvalObjVec &call) {
+    // kept as [proc, results in reverse order, the rest of lists ...]
+    EvalObj *acc;
+    if (!res)
+    {
+        if (state.size() < 2) EXC_WRONG_ARG_NUM;
+        if (!state[0]->is_opt_obj())
+            throw TokenError("an operator", RUN_ERR_WRONG_TYPE);
+        acc = empty_list;
+        state.insert(state.begin() + 1, acc);
+    }
+    else
+        acc = state[1];
+    // stop at the end of the shortest list
+    if (lists_exhausted(state, 2))
+    {
+        if (for_each) return unspec_obj;
+        return reverse_onto(acc, res ? new Pair(res, empty_list) : empty_list);
+    }
+    keep.push_back(state[0]);
+    keep.push_back(res && !for_each ? new Pair(res, acc) : acc);
+    call.push_back(state[0]);
+    lists_advance(state, 2, keep, call);
+    return NULL;
+}
+
+SpecialOptFold::SpecialOptFold(FoldOrder _order) :
+    SpecialOptCaller(_order == FOLD ? "fold" :
+                    _order == FOLD_LEFT ? "fold-left" : "fold-right"),
+    order(_order) {}
+
+EvalObj *SpecialOptFold::step(EvalObjVec &state, EvalObj *res,
+        EvalObjVec &keep, EvalObjVec &call) {
+    // kept as [proc, the rest of lists ...], with the accumulated value
+    // being the result of the last call
+    if (!res)
+    {
+        if (state.size() < 3) EXC_WRONG_ARG_NUM;
+        if (!state[0]->is_opt_obj())
+            throw TokenError("an operator", RUN_ERR_WRONG_TYPE);
+        res = state[1];
+        state.erase(state.begin() + 1);
+        if (lists_exhausted(state, 1)) return res;
+        if (order == FOLD_RIGHT)
+        {
+            // walk the reversed prefixes as long as the shortest list
+            size_t len = 0;
+            for (EvalObj *p = state[1]; p->is_pair_obj();
+                    p = TO_PAIR(p)->cdr)
+                len++;
+            for (size_t i = 2; i < state.size(); i++)
+            {
+                size_t cnt = 0;
+                for (EvalObj *p = state[i]; p->is_pair_obj() && cnt < len;
+                        p = TO_PAIR(p)->cdr)
+                    cnt++;
+                len = cnt;
+            }
+            for (size_t i = 1; i < state.size(); i++)
+            {
+                EvalObj *rev = empty_list, *p = state[i];
+                for (size_t j = 0; j < len; j++, p = TO_PAIR(p)->cdr)
+                    rev = new Pair(TO_PAIR(p)->car, rev);
+                state[i] = rev;
+            }
+        }
+    }
+    if (lists_exhausted(state, 1)) return res;
+    keep.push_back(state[0]);
+    call.push_back(state[0]);
+    if (order == FOLD_LEFT) call.push_back(res);
+    lists_advance(state, 1, keep, call);
+    if (order != FOLD_LEFT) call.push_back(res);
+    return NULL;
+}
+
+SpecialOptFilter::SpecialOptFilter(bool _remove) :
+    SpecialOptCaller(_remove ? "remove" : "filter"), remove(_remove) {}
+
+EvalObj *SpecialOptFilter::step(EvalObjVec &state, EvalObj *res,
+        EvalObjVec &keep, EvalObjVec &call) {
+    // kept as [pred, the elements kept in reverse order, the rest of the
+    // list starting from the element being tested]
+    EvalObj *acc, *lst;
+    if (!res)
+    {
+        if (state.size() != 2) EXC_WRONG_ARG_NUM;
+        if (!state[0]->is_opt_obj())
+            throw TokenError("an operator", RUN_ERR_WRONG_TYPE);
+        acc = empty_list;
+        lst = state[1];
+    }
+    else
+    {
+        acc = state[1];
+        lst = state[2];
+    }
+    EvalObj *tail = empty_list;
+    if (res)
+    {
+        bool take = res->is_true() != remove;
+        lst = TO_PAIR(lst)->cdr;
+        if (lst == empty_list)
+            tail = take ? new Pair(TO_PAIR(state[2])->car, empty_list) :
+                            empty_list;
+        else if (take)
+            acc = new Pair(TO_PAIR(state[2])->car, acc);
+    }
+    if (lst == empty_list)
+        return reverse_onto(acc, tail);
+    if (!lst->is_pair_obj())
+        throw TokenError("a list", RUN_ERR_WRONG_TYPE);
+    keep.push_back(state[0]);
+    keep.push_back(acc);
+    keep.push_back(lst);
+    call.push_back(state[0]);
+    call.push_back(TO_PAIR(lst)->car);
+    return NULL;
+}
+
+SpecialOptVectorMap::SpecialOptVectorMap(bool _for_each) :
+    SpecialOptCaller(_for_each ? "vector-for-each" : "vector-map"),
+    for_each(_for_each) {}
+
+EvalObj *SpecialOptVectorMap::step(EvalObjVec &state, EvalObj *res,
+        EvalObjVec &keep, EvalObjVec &call) {
+    // kept as [proc, the results so far (or the cursor for `for-each`),
+    // vectors ...], so the position is the number of the results
+    EvalObj *acc;
+    size_t idx;
+    if (!res)
+    {
+        if (state.size() < 2) EXC_WRONG_ARG_NUM;
+        if (!state[0]->is_opt_obj())
+            throw TokenError("an operator", RUN_ERR_WRONG_TYPE);
+        for (size_t i = 1; i < state.size(); i++)
+            if (!state[i]->is_vect_obj())
+                throw TokenError("a vector", RUN_ERR_WRONG_TYPE);
+        acc = NULL;
+        state.insert(state.begin() + 1, acc);
+        idx = 0;
+    }
+    else if (for_each)
+    {
+        acc = state[1];
+        idx = ++static_cast<HomoVecObj*>(acc)->elems<uint64_t>()[0];
+    }
+    else
+    {
+        acc = state[1];
+        static_cast<VecObj*>(acc)->push_back(res);
+        idx = static_cast<VecObj*>(acc)->get_size();
+    }
+    // stop at the end of the shortest vector
+    size_t len = static_cast<VecObj*>(state[2])->get_size();
+    for (size_t i = 3; i < state.size(); i++)
+        len = std::min(len, static_cast<VecObj*>(state[i])->get_size());
+    if (idx >= len)
+    {
+        if (for_each) return unspec_obj;
+        return acc ? acc : new VecObj();
+    }
+    if (!acc)
+    {
+        if (for_each)
+            acc = new HomoVecObj(HOMO_U64, 1);
+        else
+        {
+            acc = new VecObj();
+            static_cast<VecObj*>(acc)->vec.reserve(len);
+        }
+    }
+    keep.push_back(state[0]);
+    keep.push_back(acc);
+    call.push_back(state[0]);
+    for (size_t i = 2; i < state.size(); i++)
+    {
+        keep.push_back(state[i]);
+        call.push_back(static_cast<VecObj*>(state[i])->get(idx));
+    }
+    return NULL;
+}
+
+/** Test if `a` is less than `b` as `<` does */
+static bool num_less(NumObj *a, NumObj *b) {
+    bool res;
+    NumObj *conv;
+    // upper type conversion
+    if (a->level < b->level)
+    {
+        res = a->lt(conv = a->convert(b));
+        delete conv;
+    }
+    else if (a->level > b->level)
+    {
+        res = (conv = b->convert(a))->lt(b);
+        delete conv;
+    }
+    else res = a->lt(b);
+    return res;
+}
+
+/** The order of `<` and `>` on real numbers, or of `string<?` and
+ * `string>?` on strings */
+struct NativeOrder {
+    bool num, desc;
+    NativeOrder(bool _num, bool _desc) : num(_num), desc(_desc) {}
+    bool operator()(EvalObj *a, EvalObj *b) const {
+        if (desc) std::swap(a, b);
+        if (num)
+            return num_less(static_cast<NumObj*>(a), static_cast<NumObj*>(b));
+        return static_cast<StrObj*>(a)->lt(static_cast<StrObj*>(b));
+    }
+};
+
+/** Sort `elems` without calling `proc` if it is one of the builtin
+ * comparisons and applies to all elements. Only the two sorted runs split
+ * at `mid` are merged if `mid` is not zero.
+ * @return false if `proc` has to be called */
+static bool sort_native(EvalObjVec &elems, size_t mid, EvalObj *proc) {
+    if (!(proc->get_otype() & CLS_BUILTIN_OBJ)) return false;
+    const string &name = static_cast<BuiltinProcObj*>(proc)->get_name();
+    bool num;
+    if (name == "<" || name == ">")
+    {
+        for (size_t i = 0; i < elems.size(); i++)
+            if (!elems[i]->is_num_obj() ||
+                static_cast<NumObj*>(elems[i])->level == NUM_LVL_COMP)
+                return false;
+        num = true;
+    }
+    else if (name == "string<?" || name == "string>?")
+    {
+        for (size_t i = 0; i < elems.size(); i++)
+            if (!elems[i]->is_str_obj()) return false;
+        num = false;
+    }
+    else return false;
+    NativeOrder order(num, name == ">" || name == "string>?");
+    if (mid)
+        std::inplace_merge(elems.begin(), elems.begin() + mid,
+                            elems.end(), order);
+    else
+        std::stable_sort(elems.begin(), elems.end(), order);
+    return true;
+}
+
+/** Append the elements of the list `lst` to `elems` */
+static void list_elems(EvalObj *lst, EvalObjVec &elems) {
+    for (; lst->is_pair_obj(); lst = TO_PAIR(lst)->cdr)
+        elems.push_back(TO_PAIR(lst)->car);
+    if (lst != empty_list)
+        throw TokenError("a list", RUN_ERR_WRONG_TYPE);
+}
+
+/** Move `elems` into a new vector */
+static VecObj *vec_of_elems(EvalObjVec &elems) {
+    VecObj *res = new VecObj();
+    res->vec.swap(elems);
+    for (size_t i = 0; i < res->vec.size(); i++)
+        gc.attach(res->vec[i]);
+    return res;
+}
+
+/** Make the sorted `elems` a sequence as `seq` is */
+static EvalObj *sort_result(EvalObjVec &elems, EvalObj *seq) {
+    if (seq->is_vect_obj())
+        return vec_of_elems(elems);
+    EvalObj *res = empty_list;
+    for (size_t i = elems.size(); i > 0; i--)
+        res = new Pair(elems[i - 1], res);
+    return res;
+}
+
+/** The fields of the cursor of a merge sort */
+enum {
+    SORT_WIDTH,     /**< The width of the runs in this pass */
+    SORT_LO,        /**< The start of the two runs being merged */
+    SORT_LEFT,      /**< The position in the left run */
+    SORT_RIGHT,     /**< The position in the right run */
+    SORT_FIELD_NUM
+};
+
+static const char *SORT_NAME[] = {"sort", "list-sort", "vector-sort",
+                                "vector-sort!", "merge"};
+
+SpecialOptSort::SpecialOptSort(SortMode _mode) :
+    SpecialOptCaller(SORT_NAME[_mode]), mode(_mode) {}
+
+EvalObj *SpecialOptSort::step(EvalObjVec &state, EvalObj *res,
+        EvalObjVec &keep, EvalObjVec &call) {
+    // kept as [less?, the source and the destination of this pass, the
+    // cursor, the sequence given]
+    EvalObj *proc, *seq;
+    VecObj *src, *dst;
+    HomoVecObj *cur;
+    uint64_t *c;
+    size_t n;
+    if (!res)
+    {
+        size_t mid = 0;
+        if (state.size() != (mode == SORT_MERGE ? 3 : 2)) EXC_WRONG_ARG_NUM;
+        proc = mode == SORT_SEQ || mode == SORT_MERGE ?
+                state.back() : state[0];
+        seq = mode == SORT_SEQ || mode == SORT_MERGE ? state[0] : state[1];
+        if (!proc->is_opt_obj())
+            throw TokenError("an operator", RUN_ERR_WRONG_TYPE);
+        if (mode == SORT_VECTOR_INPLACE)
+        {
+            if (!seq->is_vect_obj())
+                throw TokenError("a vector", RUN_ERR_WRONG_TYPE);
+            // the runs are merged between the vector and a buffer, and
+            // only the references are reordered on the fast path
+            src = static_cast<VecObj*>(seq);
+            n = src->get_size();
+            if (n < 2 || sort_native(src->vec, 0, proc))
+                return unspec_obj;
+        }
+        else
+        {
+            EvalObjVec elems;
+            if (mode == SORT_MERGE)
+            {
+                list_elems(state[0], elems);
+                mid = elems.size();
+                list_elems(state[1], elems);
+                if (mid == 0) return state[1];
+                if (mid == elems.size()) return state[0];
+            }
+            else if (seq->is_vect_obj() && mode != SORT_LIST)
+                elems = static_cast<VecObj*>(seq)->vec;
+            else if (mode == SORT_VECTOR)
+                throw TokenError("a vector", RUN_ERR_WRONG_TYPE);
+            else
+                list_elems(seq, elems);
+            n = elems.size();
+            if (n < 2 || sort_native(elems, mid, proc))
+                return sort_result(elems, seq);
+            src = vec_of_elems(elems);
+        }
+        dst = new VecObj(n, unspec_obj);
+        cur = new HomoVecObj(HOMO_U64, SORT_FIELD_NUM);
+        c = cur->elems<uint64_t>();
+        c[SORT_WIDTH] = c[SORT_RIGHT] = mid ? mid : 1;
+        c[SORT_LO] = c[SORT_LEFT] = 0;
+    }
+    else
+    {
+        proc = state[0];
+        src = static_cast<VecObj*>(state[1]);
+        dst = static_cast<VecObj*>(state[2]);
+        cur = static_cast<HomoVecObj*>(state[3]);
+        seq = state[4];
+        c = cur->elems<uint64_t>();
+        n = src->get_size();
+        // the head of the right run goes first only if it is less, so the
+        // sort is stable
+        size_t k = c[SORT_LEFT] + c[SORT_RIGHT] -
+                    std::min<size_t>(c[SORT_LO] + c[SORT_WIDTH], n);
+        dst->set(k, src->get(res->is_true() ?
+                                c[SORT_RIGHT]++ : c[SORT_LEFT]++));
+    }
+    for (;;)
+    {
+        // `merge` takes a single merge of the two lists
+        size_t lo = c[SORT_LO], w = c[SORT_WIDTH];
+        size_t mid = std::min(lo + w, n);
+        size_t hi = mode == SORT_MERGE ? n : std::min(lo + w * 2, n);
+        if (c[SORT_LEFT] < mid && c[SORT_RIGHT] < hi)
+        {
+            keep.push_back(proc);
+            keep.push_back(src);
+            keep.push_back(dst);
+            keep.push_back(cur);
+            keep.push_back(seq);
+            call.push_back(proc);
+            call.push_back(src->get(c[SORT_RIGHT]));
+            call.push_back(src->get(c[SORT_LEFT]));
+            return NULL;
+        }
+        // one of the runs is exhausted, so the rest of the other follows
+        size_t k = c[SORT_LEFT] + c[SORT_RIGHT] - mid;
+        while (c[SORT_LEFT] < mid)
+            dst->set(k++, src->get(c[SORT_LEFT]++));
+        while (c[SORT_RIGHT] < hi)
+            dst->set(k++, src->get(c[SORT_RIGHT]++));
+        if (hi < n)
+        {
+            c[SORT_LO] = c[SORT_LEFT] = hi;
+            c[SORT_RIGHT] = std::min(hi + w, n);
+            continue;
+        }
+        std::swap(src, dst);
+        c[SORT_WIDTH] = w *= 2;
+        if (w >= n || mode == SORT_MERGE) break;
+        c[SORT_LO] = c[SORT_LEFT] = 0;
+        c[SORT_RIGHT] = w;
+    }
+    if (mode == SORT_VECTOR_INPLACE)
+    {
+        VecObj *vec = static_cast<VecObj*>(seq);
+        if (src != vec)
+            for (size_t i = 0; i < n; i++)
+                vec->set(i, src->get(i));
+        return unspec_obj;
+    }
+    if (seq->is_vect_obj()) return src;
+    return sort_result(src->vec, seq);
+}
+
 /* The following lines are the implementation of various simple built-in
  * procedures. Some library procdures are implemented here for the sake of
  * efficiency. */
@@ -658,7 +1367,7 @@ BUILTIN_PROC_DEF(pair_cdr) {
 
 
 BUILTIN_PROC_DEF(make_list) {
-    return gc.attach(args);     // Or it will be GCed
+    return args;    // attached by the caller before `args` is released
 }
 
 BUILTIN_PROC_DEF(num_add) {
@@ -1129,6 +1838,54 @@ BUILTIN_PROC_DEF(reverse) {
     return tail;
 }
 
+/** Find the first pair of `lst` whose car satisfies `same` with `obj` */
+static EvalObj *list_member(EvalObj *obj, EvalObj *lst,
+                            bool (*same)(EvalObj *, EvalObj *)) {
+    for (; lst->is_pair_obj(); lst = TO_PAIR(lst)->cdr)
+        if (same(obj, TO_PAIR(lst)->car))
+            return lst;
+    if (lst != empty_list)
+        throw TokenError("a list", RUN_ERR_WRONG_TYPE);
+    return new BoolObj(false);
+}
+
+/** Find the first pair of the association list `lst` whose car satisfies
+ * `same` with `obj` */
+static EvalObj *list_assoc(EvalObj *obj, EvalObj *lst,
+                            bool (*same)(EvalObj *, EvalObj *)) {
+    for (; lst->is_pair_obj(); lst = TO_PAIR(lst)->cdr)
+    {
+        EvalObj *entry = TO_PAIR(lst)->car;
+        if (!entry->is_pair_obj())
+            throw TokenError("a pair", RUN_ERR_WRONG_TYPE);
+        if (same(obj, TO_PAIR(entry)->car))
+            return entry;
+    }
+    if (lst != empty_list)
+        throw TokenError("a list", RUN_ERR_WRONG_TYPE);
+    return new BoolObj(false);
+}
+
+BUILTIN_PROC_DEF(memv) {
+    ARGS_EXACTLY_TWO;
+    return list_member(args->car, TO_PAIR(args->cdr)->car, is_eqv_obj);
+}
+
+BUILTIN_PROC_DEF(member) {
+    ARGS_EXACTLY_TWO;
+    return list_member(args->car, TO_PAIR(args->cdr)->car, is_equal_obj);
+}
+
+BUILTIN_PROC_DEF(assv) {
+    ARGS_EXACTLY_TWO;
+    return list_assoc(args->car, TO_PAIR(args->cdr)->car, is_eqv_obj);
+}
+
+BUILTIN_PROC_DEF(assoc) {
+    ARGS_EXACTLY_TWO;
+    return list_assoc(args->car, TO_PAIR(args->cdr)->car, is_equal_obj);
+}
+
 BUILTIN_PROC_DEF(list_tail) {
     ARGS_EXACTLY_TWO;
     EvalObj *sec = TO_PAIR(args->cdr)->car;
@@ -1152,164 +1909,140 @@ BUILTIN_PROC_DEF(list_tail) {
         return ptr;
 }
 
-BUILTIN_PROC_DEF(is_eqv) {
-    ARGS_EXACTLY_TWO;
-    EvalObj *obj1 = args->car;
-    EvalObj *obj2 = TO_PAIR(args->cdr)->car;
+/** Compare two numbers as `eqv?` does */
+static bool num_eqv(NumObj *num1, NumObj *num2) {
+    if (num1->is_exact() != num2->is_exact())
+        return false;
+    if (num1->level < num2->level)
+        std::swap(num1, num2);
+    NumObj *conv = num2->convert(num1);
+    bool res = num2->eq(conv);
+    delete conv;
+    return res;
+}
+
+bool is_eqv_obj(EvalObj *obj1, EvalObj *obj2) {
     int otype = obj1->get_otype();
 
-    if (otype != obj2->get_otype()) return new BoolObj(false);
+    if (otype != obj2->get_otype()) return false;
     if (otype & CLS_BOOL_OBJ)
-        return new BoolObj(
-                static_cast<BoolObj*>(obj1)->val ==
-                static_cast<BoolObj*>(obj2)->val);
+        return static_cast<BoolObj*>(obj1)->val ==
+                static_cast<BoolObj*>(obj2)->val;
     if (otype & CLS_SYM_OBJ)
-        return new BoolObj(
-                static_cast<SymObj*>(obj1)->val ==
-                static_cast<SymObj*>(obj2)->val);
+        return static_cast<SymObj*>(obj1)->val ==
+                static_cast<SymObj*>(obj2)->val;
     if (otype & CLS_NUM_OBJ)
-    {
-        NumObj *num1 = static_cast<NumObj*>(obj1);
-        NumObj *num2 = static_cast<NumObj*>(obj2);
-        if (num1->is_exact() != num2->is_exact())
-            return new BoolObj(false);
-        if (num1->level < num2->level)
-            return new BoolObj(num1->eq(num1->convert(num2)));
-        else
-            return new BoolObj(num2->eq(num2->convert(num1)));
-    }
+        return num_eqv(static_cast<NumObj*>(obj1),
+                        static_cast<NumObj*>(obj2));
     if (otype & CLS_CHAR_OBJ)
-        return new BoolObj(
-                static_cast<CharObj*>(obj1)->ch ==
-                static_cast<CharObj*>(obj2)->ch);    // (char=?)
-    return new BoolObj(obj1 == obj2);
+        return static_cast<CharObj*>(obj1)->ch ==
+                static_cast<CharObj*>(obj2)->ch;    // (char=?)
+    return obj1 == obj2;
 }
 
-
-BUILTIN_PROC_DEF(is_equal) {
-
-    //#define INC1(x) (++(x) == t1 ? (x) = q1:0)
-    //#define INC2(x) (++(x) == t2 ? (x) = q2:0)
-#define INC1(x) (++(x))
-#define INC2(x) (++(x))
-#define CHK1 \
-    do { \
-        if (r1 == q1 + EQUAL_QUEUE_SIZE)  \
-        throw NormalError(RUN_ERR_QUEUE_OVERFLOW); \
-    } while (0)
-
-#define CHK2 \
-    do { \
-        if (r2 == q2 + EQUAL_QUEUE_SIZE)  \
-        throw NormalError(RUN_ERR_QUEUE_OVERFLOW); \
-    } while (0)
+BUILTIN_PROC_DEF(is_eqv) {
+    ARGS_EXACTLY_TWO;
+    return new BoolObj(is_eqv_obj(args->car, TO_PAIR(args->cdr)->car));
+}
 
 
-    static EvalObj *q1[EQUAL_QUEUE_SIZE], *q2[EQUAL_QUEUE_SIZE];
+/** Compare two objects which are not containers as `equal?` does, given
+ * that they are of the same type */
+static bool equal_atom(EvalObj *a, EvalObj *b, int otype) {
+    if (otype & CLS_STR_OBJ)
+        return static_cast<StrObj*>(a)->eq(
+                static_cast<StrObj*>(b));       // (string=?)
+    if (otype & CLS_HOMO_OBJ)
+        return static_cast<HomoVecObj*>(a)->get_kind() ==
+                static_cast<HomoVecObj*>(b)->get_kind() &&
+                static_cast<HomoVecObj*>(a)->data ==
+                static_cast<HomoVecObj*>(b)->data;
+    return is_eqv_obj(a, b);
+}
 
-    ARGS_EXACTLY_TWO;
-    EvalObj **l1 = q1, **r1 = l1;
-    EvalObj **l2 = q2, **r2 = l2;
+typedef std::pair<EvalObj*, EvalObj*> EvalObjPair;
+/** The union-find forest of the containers assumed to be equal */
+typedef std::unordered_map<EvalObj*, EvalObj*> EqualSets;
 
-    *r1++ = args->car;
-    *r2++ = TO_PAIR(args->cdr)->car;
+static EvalObj *equal_find(EqualSets &sets, EvalObj *obj) {
+    for (;;)
+    {
+        EqualSets::iterator it = sets.find(obj);
+        if (it == sets.end()) return obj;
+        // path halving
+        EqualSets::iterator up = sets.find(it->second);
+        if (up != sets.end()) it->second = up->second;
+        obj = it->second;
+    }
+}
 
-    EvalObj *a, *b;
-    for (; l1 != r1; INC1(l1), INC2(l2))
+/** Record that containers `a` and `b` are being compared, unless
+ * the `cnt`-th comparison falls in the untracked part of its round
+ * @return false if they have already been taken as equal */
+static bool equal_visit(EqualSets &sets, size_t &cnt,
+                        EvalObj *a, EvalObj *b) {
+    if (cnt++ % (EQUAL_FAST_LIMIT + EQUAL_TRACK_LIMIT) < EQUAL_FAST_LIMIT)
+        return true;
+    a = equal_find(sets, a);
+    b = equal_find(sets, b);
+    if (a == b) return false;
+    sets[a] = b;
+    return true;
+}
+
+bool is_equal_obj(EvalObj *obj1, EvalObj *obj2) {
+    // Objects are compared depth-first with an explicit stack. Tracked
+    // pairs of containers are merged into a union-find forest, and a pair
+    // already in the same set is taken as equal. Every cycle keeps coming
+    // back to the tracked part of a round, so circular structures
+    // terminate, while most containers are compared without bookkeeping.
+    std::vector<EvalObjPair> stack;
+    EqualSets sets;
+    size_t cnt = 0;
+    stack.push_back(EvalObjPair(obj1, obj2));
+    while (!stack.empty())
     {
-        // Different types
-        int otype = (a = *l1)->get_otype();
-        if (otype != (b = *l2)->get_otype())
-            return new BoolObj(false);
-        if (a != empty_list && b != empty_list &&
-                otype & CLS_PAIR_OBJ)
+        obj1 = stack.back().first;
+        obj2 = stack.back().second;
+        stack.pop_back();
+        if (obj1 == obj2) continue;
+        int otype = obj1->get_otype();
+        if (otype != obj2->get_otype())
+            return false;
+        if (otype & CLS_PAIR_OBJ)
         {
-            *r1 = TO_PAIR(a)->car;
-            INC1(r1);
-            CHK1;
-            *r1 = TO_PAIR(a)->cdr;
-            INC1(r1);
-            CHK1;
-
-            *r2 = TO_PAIR(b)->car;
-            INC2(r2);
-            CHK2;
-            *r2 = TO_PAIR(b)->cdr;
-            INC2(r2);
-            CHK2;
+            if (obj1 == empty_list || obj2 == empty_list)
+                return false;
+            if (!equal_visit(sets, cnt, obj1, obj2)) continue;
+            stack.push_back(EvalObjPair(TO_PAIR(obj1)->cdr,
+                                        TO_PAIR(obj2)->cdr));
+            stack.push_back(EvalObjPair(TO_PAIR(obj1)->car,
+                                        TO_PAIR(obj2)->car));
         }
         else if (otype & CLS_VECT_OBJ)
         {
-            VecObj *va = static_cast<VecObj*>(a);
-            VecObj *vb = static_cast<VecObj*>(b);
-            if (va->get_size() != vb->get_size())
-                return new BoolObj(false);
-            for (EvalObjVec::iterator
-                    it = va->vec.begin();
-                    it != va->vec.end(); it++)
-            {
-                *r1 = *it;
-                INC1(r1);
-                CHK1;
-            }
-
-            for (EvalObjVec::iterator
-                    it = vb->vec.begin();
-                    it != vb->vec.end(); it++)
-            {
-                *r2 = *it;
-                INC2(r2);
-                CHK2;
-            }
-        }
-        else if (otype & CLS_BOOL_OBJ)
-        {
-            if (static_cast<BoolObj*>(a)->val !=
-                    static_cast<BoolObj*>(b)->val)
-                return new BoolObj(false);
-        }
-        else if (otype & CLS_SYM_OBJ)
-        {
-            if (static_cast<SymObj*>(a)->val !=
-                    static_cast<SymObj*>(b)->val)
-                return new BoolObj(false);
-        }
-        else if (otype & CLS_NUM_OBJ)
-        {
-            NumObj *num1 = static_cast<NumObj*>(a);
-            NumObj *num2 = static_cast<NumObj*>(b);
-            if (num1->is_exact() != num2->is_exact())
-                return new BoolObj(false);
-            if (num1->level < num2->level)
-            {
-                if (!num1->eq(num1->convert(num2)))
-                    return new BoolObj(false);
-            }
-            else
-            {
-                if (!num2->eq(num2->convert(num1)))
-                    return new BoolObj(false);
-            }
-        }
-        else if (otype & CLS_CHAR_OBJ)
-        {
-            if (static_cast<CharObj*>(a)->ch !=
-                    static_cast<CharObj*>(b)->ch)
-                return new BoolObj(false); // (char=?)
+            EvalObjVec &va = static_cast<VecObj*>(obj1)->vec;
+            EvalObjVec &vb = static_cast<VecObj*>(obj2)->vec;
+            if (va.size() != vb.size())
+                return false;
+            if (!equal_visit(sets, cnt, obj1, obj2)) continue;
+            // identical elements need no further comparison
+            for (size_t i = va.size(); i > 0; i--)
+                if (va[i - 1] != vb[i - 1])
+                    stack.push_back(EvalObjPair(va[i - 1], vb[i - 1]));
         }
-        else if (otype & CLS_STR_OBJ)
-        {
-            if (static_cast<StrObj*>(a)->str !=
-                    static_cast<StrObj*>(b)->str)
-                return new BoolObj(false); // (string=?)
-        }
-        else if (a != b)
-            return new BoolObj(false);
+        else if (!equal_atom(obj1, obj2, otype))
+            return false;
     }
-    return new BoolObj(true);
+    return true;
 }
 
-BUILTIN_PROC_DEF(is_number) {
+BUILTIN_PROC_DEF(is_equal) {
+    ARGS_EXACTLY_TWO;
+    return new BoolObj(is_equal_obj(args->car, TO_PAIR(args->cdr)->car));
+}
+
+BUILTIN_PROC_DEF(is_number) {
     ARGS_EXACTLY_ONE;
     return new BoolObj(args->car->is_num_obj());
 }
@@ -1439,6 +2172,194 @@ BUILTIN_PROC_DEF(num_lcm) {
     return res;
 }
 
+/* Flonum and fixnum specific arithmetic (R6RS style). These procedures
+ * only accept one representation, so they skip the level dispatch and
+ * `convert` done by the generic ones. */
+
+#define FX_RANGE_CHECK(ok) \
+    do { \
+        if (!(ok)) throw NormalError(RUN_ERR_NUMERIC_OVERFLOW); \
+    } while (0)
+
+/** Extract the double stored in a flonum, or throw */
+static inline double fl_val(EvalObj *obj) {
+    if (!obj->is_num_obj() ||
+            static_cast<NumObj*>(obj)->level != NUM_LVL_REAL)
+        throw TokenError("a flonum", RUN_ERR_WRONG_TYPE);
+    return static_cast<RealNumObj*>(obj)->real;
+}
+
+/** Extract the C integer stored in a fixnum, or throw */
+static inline long fx_val(EvalObj *obj) {
+    if (!obj->is_num_obj() ||
+            static_cast<NumObj*>(obj)->level != NUM_LVL_INT ||
+            !static_cast<IntNumObj*>(obj)->val.fits_slong_p())
+        throw TokenError("a fixnum", RUN_ERR_WRONG_TYPE);
+    return static_cast<IntNumObj*>(obj)->val.get_si();
+}
+
+BUILTIN_PROC_DEF(is_flonum) {
+    ARGS_EXACTLY_ONE;
+    return new BoolObj(args->car->is_num_obj() &&
+            static_cast<NumObj*>(args->car)->level == NUM_LVL_REAL);
+}
+
+BUILTIN_PROC_DEF(is_fixnum) {
+    ARGS_EXACTLY_ONE;
+    return new BoolObj(args->car->is_num_obj() &&
+            static_cast<NumObj*>(args->car)->level == NUM_LVL_INT &&
+            static_cast<IntNumObj*>(args->car)->val.fits_slong_p());
+}
+
+BUILTIN_PROC_DEF(fl_add) {
+    double res = 0;
+    for (; args != empty_list; args = TO_PAIR(args->cdr))
+        res += fl_val(args->car);
+    return new RealNumObj(res);
+}
+
+BUILTIN_PROC_DEF(fl_mul) {
+    double res = 1;
+    for (; args != empty_list; args = TO_PAIR(args->cdr))
+        res *= fl_val(args->car);
+    return new RealNumObj(res);
+}
+
+BUILTIN_PROC_DEF(fl_sub) {
+    ARGS_AT_LEAST_ONE;
+    double res = fl_val(args->car);
+    args = TO_PAIR(args->cdr);
+    if (args == empty_list)
+        return new RealNumObj(-res);
+    for (; args != empty_list; args = TO_PAIR(args->cdr))
+        res -= fl_val(args->car);
+    return new RealNumObj(res);
+}
+
+BUILTIN_PROC_DEF(fl_div) {
+    ARGS_AT_LEAST_ONE;
+    double res = fl_val(args->car);
+    args = TO_PAIR(args->cdr);
+    if (args == empty_list)
+        return new RealNumObj(1 / res);
+    for (; args != empty_list; args = TO_PAIR(args->cdr))
+        res /= fl_val(args->car);
+    return new RealNumObj(res);
+}
+
+#define FL_CMP_DEF(func, op) \
+    BUILTIN_PROC_DEF(func) { \
+        ARGS_AT_LEAST_ONE; \
+        double last = fl_val(args->car), opr; \
+        bool res = true; \
+        for (args = TO_PAIR(args->cdr); args != empty_list; \
+                args = TO_PAIR(args->cdr), last = opr) \
+        { \
+            opr = fl_val(args->car); \
+            if (!(last op opr)) res = false; \
+        } \
+        return new BoolObj(res); \
+    }
+
+FL_CMP_DEF(fl_lt, <)
+FL_CMP_DEF(fl_le, <=)
+FL_CMP_DEF(fl_gt, >)
+FL_CMP_DEF(fl_ge, >=)
+FL_CMP_DEF(fl_eq, ==)
+
+#define FL_UNARY_DEF(func, cfunc) \
+    BUILTIN_PROC_DEF(func) { \
+        ARGS_EXACTLY_ONE; \
+        return new RealNumObj(cfunc(fl_val(args->car))); \
+    }
+
+FL_UNARY_DEF(fl_abs, fabs)
+FL_UNARY_DEF(fl_sqrt, sqrt)
+FL_UNARY_DEF(fl_exp, exp)
+FL_UNARY_DEF(fl_log, log)
+FL_UNARY_DEF(fl_sin, sin)
+FL_UNARY_DEF(fl_cos, cos)
+FL_UNARY_DEF(fl_tan, tan)
+FL_UNARY_DEF(fl_asin, asin)
+FL_UNARY_DEF(fl_acos, acos)
+FL_UNARY_DEF(fl_atan, atan)
+FL_UNARY_DEF(fl_floor, floor)
+FL_UNARY_DEF(fl_ceiling, ceil)
+FL_UNARY_DEF(fl_round, nearbyint)
+FL_UNARY_DEF(fl_truncate, trunc)
+
+BUILTIN_PROC_DEF(fx_add) {
+    ARGS_EXACTLY_TWO;
+    long res;
+    FX_RANGE_CHECK(!__builtin_add_overflow(fx_val(args->car),
+                fx_val(TO_PAIR(args->cdr)->car), &res));
+    return new IntNumObj(res);
+}
+
+BUILTIN_PROC_DEF(fx_sub) {
+    ARGS_AT_LEAST_ONE;
+    long res, a = fx_val(args->car);
+    args = TO_PAIR(args->cdr);
+    if (args == empty_list)
+        FX_RANGE_CHECK(!__builtin_sub_overflow(0L, a, &res));
+    else
+    {
+        if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
+        FX_RANGE_CHECK(!__builtin_sub_overflow(a, fx_val(args->car), &res));
+    }
+    return new IntNumObj(res);
+}
+
+BUILTIN_PROC_DEF(fx_mul) {
+    ARGS_EXACTLY_TWO;
+    long res;
+    FX_RANGE_CHECK(!__builtin_mul_overflow(fx_val(args->car),
+                fx_val(TO_PAIR(args->cdr)->car), &res));
+    return new IntNumObj(res);
+}
+
+BUILTIN_PROC_DEF(fx_quo) {
+    ARGS_EXACTLY_TWO;
+    long a = fx_val(args->car), b = fx_val(TO_PAIR(args->cdr)->car);
+    if (b == 0) throw NormalError(RUN_ERR_NUMERIC_OVERFLOW);
+    FX_RANGE_CHECK(!(b == -1 && a == LONG_MIN));
+    return new IntNumObj(a / b);
+}
+
+BUILTIN_PROC_DEF(fx_rem) {
+    ARGS_EXACTLY_TWO;
+    long a = fx_val(args->car), b = fx_val(TO_PAIR(args->cdr)->car);
+    if (b == 0) throw NormalError(RUN_ERR_NUMERIC_OVERFLOW);
+    return new IntNumObj(b == -1 ? 0 : a % b);
+}
+
+BUILTIN_PROC_DEF(fx_abs) {
+    ARGS_EXACTLY_ONE;
+    long a = fx_val(args->car);
+    FX_RANGE_CHECK(a != LONG_MIN);
+    return new IntNumObj(a < 0 ? -a : a);
+}
+
+#define FX_CMP_DEF(func, op) \
+    BUILTIN_PROC_DEF(func) { \
+        ARGS_AT_LEAST_ONE; \
+        long last = fx_val(args->car), opr; \
+        bool res = true; \
+        for (args = TO_PAIR(args->cdr); args != empty_list; \
+                args = TO_PAIR(args->cdr), last = opr) \
+        { \
+            opr = fx_val(args->car); \
+            if (!(last op opr)) res = false; \
+        } \
+        return new BoolObj(res); \
+    }
+
+FX_CMP_DEF(fx_lt, <)
+FX_CMP_DEF(fx_le, <=)
+FX_CMP_DEF(fx_gt, >)
+FX_CMP_DEF(fx_ge, >=)
+FX_CMP_DEF(fx_eq, ==)
+
 BUILTIN_PROC_DEF(is_string) {
     ARGS_AT_LEAST_ONE;
     return new BoolObj(args->car->is_str_obj());
@@ -1494,16 +2415,386 @@ BUILTIN_PROC_DEF(string_eq) {
     return new BoolObj(static_cast<StrObj*>(obj1)->eq(static_cast<StrObj*>(obj2)));
 }
 
+/** Get the integer `val` as a size without truncating it */
+static size_t int_to_size(IntNumObj *val) {
+#ifdef GMP_SUPPORT
+    if (sgn(val->val) < 0)
+        throw TokenError("a non-negative integer", RUN_ERR_WRONG_TYPE);
+    if (!val->val.fits_ulong_p() || val->val.get_ui() > SIZE_MAX)
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    return val->val.get_ui();
+#else
+    if (val->val < 0)
+        throw TokenError("a non-negative integer", RUN_ERR_WRONG_TYPE);
+    return val->val;
+#endif
+}
+
+/** Get `obj` as an index or a size */
+static size_t to_index(EvalObj *obj) {
+    CHECK_NUMBER(obj);
+    if (static_cast<NumObj*>(obj)->level == NUM_LVL_INT)
+        return int_to_size(static_cast<IntNumObj*>(obj));
+    CHECK_EXACT(obj);
+    IntNumObj *val = static_cast<ExactNumObj*>(obj)->to_int();
+    size_t k;
+    try
+    {
+        k = int_to_size(val);
+    }
+    catch (...)
+    {
+        delete val;
+        throw;
+    }
+    delete val;
+    return k;
+}
+
+/** Get the optional [start, end) range of a sequence of `size` elements
+ * from `args` */
+static void get_range(Pair *args, size_t size, size_t &st, size_t &ed,
+                    const string &name) {
+    st = 0;
+    ed = size;
+    if (args == empty_list) return;
+    st = to_index(args->car);
+    args = TO_PAIR(args->cdr);
+    if (args != empty_list)
+    {
+        if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
+        ed = to_index(args->car);
+    }
+    if (st > ed || ed > size)
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+}
+
+/** Get the string in the first argument */
+static StrObj *to_string(Pair *args, const string &name) {
+    if (args == empty_list) EXC_WRONG_ARG_NUM;
+    if (!args->car->is_str_obj())
+        throw TokenError("a string", RUN_ERR_WRONG_TYPE);
+    return static_cast<StrObj*>(args->car);
+}
+
+/** Get `obj` as a character */
+static char to_char(EvalObj *obj) {
+    if (!(obj->get_otype() & CLS_CHAR_OBJ))
+        throw TokenError("a character", RUN_ERR_WRONG_TYPE);
+    return static_cast<CharObj*>(obj)->ch;
+}
+
+BUILTIN_PROC_DEF(string_ci_cmp) {
+    // string-ci=?, string-ci<?, string-ci>?, string-ci<=? and string-ci>=?
+    ARGS_EXACTLY_TWO;
+    StrObj *str1 = to_string(args, name);
+    StrObj *str2 = to_string(TO_PAIR(args->cdr), name);
+    const char *p1 = str1->data(), *p2 = str2->data();
+    size_t len1 = str1->length(), len2 = str2->length();
+    int res = 0;
+    for (size_t i = 0; !res && i < len1 && i < len2; i++)
+        res = tolower((unsigned char)p1[i]) - tolower((unsigned char)p2[i]);
+    if (!res) res = len1 < len2 ? -1 : len1 > len2;
+    const string op = name.substr(9, name.length() - 10);
+    if (op == "=") return new BoolObj(res == 0);
+    if (op == "<") return new BoolObj(res < 0);
+    if (op == ">") return new BoolObj(res > 0);
+    if (op == "<=") return new BoolObj(res <= 0);
+    return new BoolObj(res >= 0);
+}
+
+BUILTIN_PROC_DEF(make_string) {
+    ARGS_AT_LEAST_ONE;
+    size_t len = to_index(args->car);
+    char fill = ' ';
+    args = TO_PAIR(args->cdr);
+    if (args != empty_list)
+    {
+        if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
+        fill = to_char(args->car);
+    }
+    return new StrObj(string(len, fill));
+}
+
+BUILTIN_PROC_DEF(string_of_chars) {
+    string res;
+    for (; args != empty_list; args = TO_PAIR(args->cdr))
+        res += to_char(args->car);
+    return new StrObj(res);
+}
+
+BUILTIN_PROC_DEF(string_length) {
+    ARGS_EXACTLY_ONE;
+    return new IntNumObj(to_string(args, name)->length());
+}
+
+BUILTIN_PROC_DEF(string_ref) {
+    ARGS_EXACTLY_TWO;
+    StrObj *str = to_string(args, name);
+    size_t k = to_index(TO_PAIR(args->cdr)->car);
+    if (k >= str->length())
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    return new CharObj(str->data()[k]);
+}
+
+BUILTIN_PROC_DEF(string_set) {
+    StrObj *str = to_string(args, name);
+    args = TO_PAIR(args->cdr);
+    if (args == empty_list || args->cdr == empty_list ||
+            TO_PAIR(args->cdr)->cdr != empty_list)
+        EXC_WRONG_ARG_NUM;
+    size_t k = to_index(args->car);
+    char ch = to_char(TO_PAIR(args->cdr)->car);
+    if (k >= str->length())
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    str->set(k, ch);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(substring) {
+    // (substring string start end), and `string-copy` with the optional
+    // range, both sharing the buffer until either is changed
+    StrObj *str = to_string(args, name);
+    size_t st, ed;
+    if (name == "substring" && (args->cdr == empty_list ||
+                TO_PAIR(args->cdr)->cdr == empty_list))
+        EXC_WRONG_ARG_NUM;
+    get_range(TO_PAIR(args->cdr), str->length(), st, ed, name);
+    return new StrObj(str, st, ed);
+}
+
+BUILTIN_PROC_DEF(string_append) {
+    if (args == empty_list)
+        return new StrObj("");
+    StrObj *res = to_string(args, name);
+    size_t len = res->length();
+    for (Pair *ptr = TO_PAIR(args->cdr); ptr != empty_list;
+            ptr = TO_PAIR(ptr->cdr))
+        len += to_string(ptr, name)->length();
+    res = new StrObj(res, 0, res->length());
+    if (args->cdr != empty_list && res->length())
+        res->reserve(len);
+    for (args = TO_PAIR(args->cdr); args != empty_list;
+            args = TO_PAIR(args->cdr))
+    {
+        StrObj *part = new StrObj(res, static_cast<StrObj*>(args->car));
+        delete res;
+        res = part;
+    }
+    return res;
+}
+
+BUILTIN_PROC_DEF(string_to_list) {
+    StrObj *str = to_string(args, name);
+    size_t st, ed;
+    get_range(TO_PAIR(args->cdr), str->length(), st, ed, name);
+    const char *ptr = str->data();
+    EvalObj *res = empty_list;
+    for (size_t i = ed; i > st; i--)
+        res = new Pair(new CharObj(ptr[i - 1]), res);
+    return res;
+}
+
+BUILTIN_PROC_DEF(list_to_string) {
+    ARGS_EXACTLY_ONE;
+    string res;
+    EvalObj *lst = args->car;
+    for (; lst->is_pair_obj(); lst = TO_PAIR(lst)->cdr)
+        res += to_char(TO_PAIR(lst)->car);
+    if (lst != empty_list)
+        throw TokenError("a list", RUN_ERR_WRONG_TYPE);
+    return new StrObj(res);
+}
+
+BUILTIN_PROC_DEF(string_fill) {
+    // (string-fill! string char [start [end]])
+    StrObj *str = to_string(args, name);
+    args = TO_PAIR(args->cdr);
+    if (args == empty_list) EXC_WRONG_ARG_NUM;
+    char ch = to_char(args->car);
+    size_t st, ed;
+    get_range(TO_PAIR(args->cdr), str->length(), st, ed, name);
+    str->fill(ch, st, ed);
+    return unspec_obj;
+}
+
+/** Make the result of a search in a string */
+static EvalObj *search_result(size_t pos) {
+    if (pos == STR_NPOS) return new BoolObj(false);
+    return new IntNumObj(pos);
+}
+
+BUILTIN_PROC_DEF(string_search_forward) {
+    // (string-search-forward pattern string [start])
+    if (args == empty_list || args->cdr == empty_list) EXC_WRONG_ARG_NUM;
+    StrObj *pat = to_string(args, name);
+    StrObj *str = to_string(TO_PAIR(args->cdr), name);
+    size_t st = 0;
+    args = TO_PAIR(TO_PAIR(args->cdr)->cdr);
+    if (args != empty_list)
+    {
+        if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
+        if ((st = to_index(args->car)) > str->length())
+            throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    }
+    size_t pos = str_find(str->data() + st, str->length() - st,
+                            pat->data(), pat->length());
+    return search_result(pos == STR_NPOS ? pos : st + pos);
+}
+
+BUILTIN_PROC_DEF(string_contains) {
+    // (string-contains string pattern [start [end]])
+    if (args == empty_list || args->cdr == empty_list) EXC_WRONG_ARG_NUM;
+    StrObj *str = to_string(args, name);
+    StrObj *pat = to_string(TO_PAIR(args->cdr), name);
+    size_t st, ed;
+    get_range(TO_PAIR(TO_PAIR(args->cdr)->cdr), str->length(), st, ed, name);
+    size_t pos = str_find(str->data() + st, ed - st,
+                            pat->data(), pat->length());
+    return search_result(pos == STR_NPOS ? pos : st + pos);
+}
+
+BUILTIN_PROC_DEF(string_index) {
+    // (string-index string char [start [end]])
+    if (args == empty_list || args->cdr == empty_list) EXC_WRONG_ARG_NUM;
+    StrObj *str = to_string(args, name);
+    char ch = to_char(TO_PAIR(args->cdr)->car);
+    size_t st, ed;
+    get_range(TO_PAIR(TO_PAIR(args->cdr)->cdr), str->length(), st, ed, name);
+    size_t pos = str_find_char(str->data() + st, ed - st, ch);
+    return search_result(pos == STR_NPOS ? pos : st + pos);
+}
+
+BUILTIN_PROC_DEF(string_split) {
+    // (string-split string delimiter), where the delimiter is a character
+    // or a non-empty string, and the parts share the buffer of `string`
+    ARGS_EXACTLY_TWO;
+    StrObj *str = to_string(args, name);
+    EvalObj *delim = TO_PAIR(args->cdr)->car;
+    const char *pat;
+    char ch;
+    size_t plen;
+    if (delim->get_otype() & CLS_CHAR_OBJ)
+    {
+        ch = static_cast<CharObj*>(delim)->ch;
+        pat = &ch;
+        plen = 1;
+    }
+    else
+    {
+        StrObj *dstr = to_string(TO_PAIR(args->cdr), name);
+        if (!dstr->length())
+            throw TokenError("a non-empty string", RUN_ERR_WRONG_TYPE);
+        pat = dstr->data();
+        plen = dstr->length();
+    }
+    const char *ptr = str->data();
+    size_t len = str->length();
+    EvalObjVec parts;
+    for (size_t st = 0; ; )
+    {
+        size_t pos = str_find(ptr + st, len - st, pat, plen);
+        size_t ed = pos == STR_NPOS ? len : st + pos;
+        parts.push_back(new StrObj(str, st, ed));
+        if (pos == STR_NPOS) break;
+        st = ed + plen;
+    }
+    EvalObj *res = empty_list;
+    for (size_t i = parts.size(); i > 0; i--)
+        res = new Pair(parts[i - 1], res);
+    return res;
+}
+
+BUILTIN_PROC_DEF(string_prefix) {
+    // (string-prefix? prefix string) and (string-suffix? suffix string)
+    ARGS_EXACTLY_TWO;
+    StrObj *pat = to_string(args, name);
+    StrObj *str = to_string(TO_PAIR(args->cdr), name);
+    size_t plen = pat->length(), len = str->length();
+    if (plen > len) return new BoolObj(false);
+    size_t st = name == "string-suffix?" ? len - plen : 0;
+    return new BoolObj(!memcmp(str->data() + st, pat->data(), plen));
+}
+
+/** Get the optional radix of a number conversion */
+static int opt_radix(Pair *args, const string &name) {
+    if (args == empty_list) return 10;
+    if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
+    size_t radix = to_index(args->car);
+    if (radix != 2 && radix != 8 && radix != 10 && radix != 16)
+        throw TokenError("2, 8, 10 or 16", RUN_ERR_WRONG_TYPE);
+    return radix;
+}
+
+BUILTIN_PROC_DEF(number_to_string) {
+    ARGS_AT_LEAST_ONE;
+    CHECK_NUMBER(args->car);
+    NumObj *num = static_cast<NumObj*>(args->car);
+    int radix = opt_radix(TO_PAIR(args->cdr), name);
+    if (radix == 10)
+        return new StrObj(num->ext_repr());
+    CHECK_EXACT(num);
+#ifdef GMP_SUPPORT
+    if (num->level == NUM_LVL_INT)
+        return new StrObj(static_cast<IntNumObj*>(num)->val.get_str(radix));
+    return new StrObj(static_cast<RatNumObj*>(num)->val.get_str(radix));
+#else
+    throw TokenError("10", RUN_ERR_WRONG_TYPE);
+#endif
+}
+
+/** Get the value of the digit `ch`, which is 36, beyond any radix, if
+ * `ch` is not a digit */
+static int digit_value(char ch) {
+    if ('0' <= ch && ch <= '9') return ch - '0';
+    if ('a' <= ch && ch <= 'z') return ch - 'a' + 10;
+    if ('A' <= ch && ch <= 'Z') return ch - 'A' + 10;
+    return 36;
+}
+
+BUILTIN_PROC_DEF(string_to_number) {
+    ARGS_AT_LEAST_ONE;
+    StrObj *str = to_string(args, name);
+    int radix = opt_radix(TO_PAIR(args->cdr), name);
+    EvalObj *res = NULL;
+    if (radix == 10)
+        res = str_to_num(str->data(), str->length());
+#ifdef GMP_SUPPORT
+    else
+    {
+        // exact integers only
+        const char *ptr = str->data(), *end = ptr + str->length();
+        bool neg = false;
+        if (ptr != end && (*ptr == '+' || *ptr == '-')) neg = *ptr++ == '-';
+        // set_str skips white space, so check every digit here
+        const char *p = ptr;
+        while (p != end && digit_value(*p) < radix) p++;
+        if (ptr != end && p == end)
+        {
+            mpz_class val;
+            if (!val.set_str(string(ptr, end), radix))
+                res = new IntNumObj(neg ? mpz_class(-val) : val);
+        }
+    }
+#endif
+    return res ? res : new BoolObj(false);
+}
+
+BUILTIN_PROC_DEF(symbol_to_string) {
+    ARGS_EXACTLY_ONE;
+    CHECK_SYMBOL(args->car);
+    return new StrObj(static_cast<SymObj*>(args->car)->val);
+}
+
+BUILTIN_PROC_DEF(string_to_symbol) {
+    ARGS_EXACTLY_ONE;
+    StrObj *str = to_string(args, name);
+    return new SymObj(str->data(), str->length());
+}
+
 BUILTIN_PROC_DEF(make_vector) {
     ARGS_AT_LEAST_ONE;
-    EvalObj *first = args->car;
-    CHECK_NUMBER(first);
-    CHECK_EXACT(first);
-    IntNumObj *val = static_cast<ExactNumObj*>(first)->to_int();
-    ssize_t len = val->get_i();
-    delete val;
-    if (len < 0)
-        throw TokenError("a non-negative integer", RUN_ERR_WRONG_TYPE);
+    size_t len = to_index(args->car);
 
     EvalObj *fill;
 
@@ -1515,7 +2806,7 @@ BUILTIN_PROC_DEF(make_vector) {
     else
         EXC_WRONG_ARG_NUM;
 
-    VecObj *res = new VecObj(size_t(len), fill);
+    VecObj *res = new VecObj(len, fill);
     return res;
 }
 
@@ -1529,14 +2820,7 @@ BUILTIN_PROC_DEF(vector_set) {
     args = TO_PAIR(args->cdr);
     if (args == empty_list) EXC_WRONG_ARG_NUM;
 
-    EvalObj *second = args->car;
-    CHECK_NUMBER(second);
-    CHECK_EXACT(second);
-    IntNumObj *val = static_cast<ExactNumObj*>(second)->to_int();
-    ssize_t k = val->get_i();
-    delete val;
-    if (k < 0)
-        throw TokenError("a non-negative integer", RUN_ERR_WRONG_TYPE);
+    size_t k = to_index(args->car);
 
     args = TO_PAIR(args->cdr);
     if (args == empty_list) EXC_WRONG_ARG_NUM;
@@ -1557,14 +2841,9 @@ BUILTIN_PROC_DEF(vector_ref) {
     if (args == empty_list) EXC_WRONG_ARG_NUM;
     if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
 
-    EvalObj *second = args->car;
-    CHECK_NUMBER(second);
-    CHECK_EXACT(second);
-    IntNumObj *val = static_cast<ExactNumObj*>(second)->to_int();
-    ssize_t k = val->get_i();
-    delete val;
-    if (k < 0)
-        throw TokenError("a non-negative integer", RUN_ERR_WRONG_TYPE);
+    size_t k = to_index(args->car);
+    if (k >= vect->get_size())
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
     return vect->get(k);
 }
 
@@ -1578,6 +2857,603 @@ BUILTIN_PROC_DEF(vector_length) {
     return new IntNumObj(vect->get_size());
 }
 
+/** Get the vector in the first argument */
+static VecObj *to_vector(Pair *args, const string &name) {
+    if (args == empty_list) EXC_WRONG_ARG_NUM;
+    if (!args->car->is_vect_obj())
+        throw TokenError("a vector", RUN_ERR_WRONG_TYPE);
+    return static_cast<VecObj*>(args->car);
+}
+
+BUILTIN_PROC_DEF(vector) {
+    VecObj *res = new VecObj();
+    for (; args != empty_list; args = TO_PAIR(args->cdr))
+        res->push_back(args->car);
+    return res;
+}
+
+BUILTIN_PROC_DEF(vector_fill) {
+    // (vector-fill! vector fill [start [end]])
+    VecObj *vect = to_vector(args, name);
+    args = TO_PAIR(args->cdr);
+    if (args == empty_list) EXC_WRONG_ARG_NUM;
+    size_t st, ed;
+    get_range(TO_PAIR(args->cdr), vect->get_size(), st, ed, name);
+    EvalObj *fill = args->car;
+    for (size_t i = st; i < ed; i++)
+        vect->set(i, fill);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(vector_copy) {
+    VecObj *vect = to_vector(args, name);
+    size_t st, ed;
+    get_range(TO_PAIR(args->cdr), vect->get_size(), st, ed, name);
+    VecObj *res = new VecObj();
+    res->vec.reserve(ed - st);
+    for (size_t i = st; i < ed; i++)
+        res->push_back(vect->get(i));
+    return res;
+}
+
+BUILTIN_PROC_DEF(vector_copy_to) {
+    // (vector-copy! to at from [start [end]])
+    VecObj *to = to_vector(args, name);
+    args = TO_PAIR(args->cdr);
+    if (args == empty_list) EXC_WRONG_ARG_NUM;
+    size_t at = to_index(args->car);
+    VecObj *from = to_vector(TO_PAIR(args->cdr), name);
+    size_t st, ed;
+    get_range(TO_PAIR(TO_PAIR(args->cdr)->cdr), from->get_size(),
+                st, ed, name);
+    size_t len = ed - st;
+    if (at > to->get_size() || len > to->get_size() - at)
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    // hold the new elements before dropping the old ones, as they may
+    // overlap
+    for (size_t i = st; i < ed; i++)
+        gc.attach(from->vec[i]);
+    for (size_t i = at; i < at + len; i++)
+        gc.expose(to->vec[i]);
+    memmove(to->vec.data() + at, from->vec.data() + st,
+            len * sizeof(EvalObj*));
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(vector_grow) {
+    // (vector-grow vector k), a new vector with the elements of `vector`
+    // followed by unspecified values
+    ARGS_EXACTLY_TWO;
+    VecObj *vect = to_vector(args, name);
+    size_t len = to_index(TO_PAIR(args->cdr)->car);
+    if (len < vect->get_size())
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    VecObj *res = new VecObj();
+    res->vec.reserve(len);
+    for (size_t i = 0; i < vect->get_size(); i++)
+        res->push_back(vect->get(i));
+    while (res->get_size() < len)
+        res->push_back(unspec_obj);
+    return res;
+}
+
+BUILTIN_PROC_DEF(vector_to_list) {
+    VecObj *vect = to_vector(args, name);
+    size_t st, ed;
+    get_range(TO_PAIR(args->cdr), vect->get_size(), st, ed, name);
+    EvalObj *res = empty_list;
+    for (size_t i = ed; i > st; i--)
+        res = new Pair(vect->get(i - 1), res);
+    return res;
+}
+
+BUILTIN_PROC_DEF(list_to_vector) {
+    ARGS_EXACTLY_ONE;
+    VecObj *res = new VecObj();
+    EvalObj *lst = args->car;
+    for (; lst->is_pair_obj(); lst = TO_PAIR(lst)->cdr)
+        res->push_back(TO_PAIR(lst)->car);
+    if (lst != empty_list)
+    {
+        delete res;
+        throw TokenError("a list", RUN_ERR_WRONG_TYPE);
+    }
+    return res;
+}
+
+/** Get the hash table in the first argument */
+static HashTableObj *to_hash_table(Pair *args, const string &name) {
+    if (args == empty_list) EXC_WRONG_ARG_NUM;
+    if (!(args->car->get_otype() & CLS_HASH_OBJ))
+        throw TokenError("a hash table", RUN_ERR_WRONG_TYPE);
+    return static_cast<HashTableObj*>(args->car);
+}
+
+/** Check the number of the arguments after the hash table */
+static Pair *hash_table_args(Pair *args, size_t num, const string &name) {
+    args = TO_PAIR(args->cdr);
+    Pair *ptr = args;
+    for (; num && ptr != empty_list; num--)
+        ptr = TO_PAIR(ptr->cdr);
+    if (num || ptr != empty_list) EXC_WRONG_ARG_NUM;
+    return args;
+}
+
+BUILTIN_PROC_DEF(make_hash_table) {
+    HashKind kind = HASH_EQUAL;
+    if (args != empty_list)
+    {
+        if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
+        // tell the kind by the equivalence predicate
+        string pred;
+        if (args->car->get_otype() & CLS_BUILTIN_OBJ)
+            pred = static_cast<BuiltinProcObj*>(args->car)->get_name();
+        if (pred == "eq?" || pred == "eqv?")
+            kind = HASH_EQV;
+        else if (pred == "string=?")
+            kind = HASH_STRING;
+        else if (pred != "equal?")
+            throw TokenError("eq?, eqv?, equal? or string=?",
+                            RUN_ERR_WRONG_TYPE);
+    }
+    return new HashTableObj(kind);
+}
+
+BUILTIN_PROC_DEF(make_weak_hash_table) {
+    if (args != empty_list) EXC_WRONG_ARG_NUM;
+    return new HashTableObj(HASH_WEAK);
+}
+
+BUILTIN_PROC_DEF(is_hash_table) {
+    ARGS_EXACTLY_ONE;
+    return new BoolObj(args->car->get_otype() & CLS_HASH_OBJ);
+}
+
+BUILTIN_PROC_DEF(hash_table_ref) {
+    HashTableObj *ht = to_hash_table(args, name);
+    args = hash_table_args(args, 1, name);
+    EvalObj *val = ht->get(args->car);
+    if (!val) throw NormalError(RUN_ERR_KEY_NOT_FOUND);
+    return val;
+}
+
+BUILTIN_PROC_DEF(hash_table_ref_default) {
+    HashTableObj *ht = to_hash_table(args, name);
+    args = hash_table_args(args, 2, name);
+    EvalObj *val = ht->get(args->car);
+    return val ? val : TO_PAIR(args->cdr)->car;
+}
+
+BUILTIN_PROC_DEF(hash_table_set) {
+    HashTableObj *ht = to_hash_table(args, name);
+    args = hash_table_args(args, 2, name);
+    ht->set(args->car, TO_PAIR(args->cdr)->car);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(hash_table_delete) {
+    HashTableObj *ht = to_hash_table(args, name);
+    args = hash_table_args(args, 1, name);
+    ht->remove(args->car);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(hash_table_contains) {
+    HashTableObj *ht = to_hash_table(args, name);
+    args = hash_table_args(args, 1, name);
+    return new BoolObj(ht->get(args->car) != NULL);
+}
+
+BUILTIN_PROC_DEF(hash_table_count) {
+    HashTableObj *ht = to_hash_table(args, name);
+    hash_table_args(args, 0, name);
+    return new IntNumObj(ht->get_count());
+}
+
+BUILTIN_PROC_DEF(hash_table_keys) {
+    HashTableObj *ht = to_hash_table(args, name);
+    hash_table_args(args, 0, name);
+    EvalObjVec keys, vals;
+    ht->get_entries(keys, vals);
+    Pair *res = empty_list;
+    for (size_t i = keys.size(); i > 0; i--)
+        res = new Pair(keys[i - 1], res);
+    return res;
+}
+
+BUILTIN_PROC_DEF(hash_table_values) {
+    HashTableObj *ht = to_hash_table(args, name);
+    hash_table_args(args, 0, name);
+    EvalObjVec keys, vals;
+    ht->get_entries(keys, vals);
+    Pair *res = empty_list;
+    for (size_t i = vals.size(); i > 0; i--)
+        res = new Pair(vals[i - 1], res);
+    return res;
+}
+
+BUILTIN_PROC_DEF(hash_table_to_alist) {
+    HashTableObj *ht = to_hash_table(args, name);
+    hash_table_args(args, 0, name);
+    EvalObjVec keys, vals;
+    ht->get_entries(keys, vals);
+    Pair *res = empty_list;
+    for (size_t i = keys.size(); i > 0; i--)
+        res = new Pair(new Pair(keys[i - 1], vals[i - 1]), res);
+    return res;
+}
+
+BUILTIN_PROC_DEF(hash_table_clear) {
+    HashTableObj *ht = to_hash_table(args, name);
+    hash_table_args(args, 0, name);
+    ht->clear();
+    return unspec_obj;
+}
+
+/** Get the kind of homogeneous vectors a builtin works on by its name, as
+ * in `make-f64vector`, `list->f64vector` and `f64vector-ref` */
+static HomoKind homo_kind_of_name(const string &name) {
+    size_t st = 0;
+    if (!name.compare(0, 5, "make-")) st = 5;
+    else if (!name.compare(0, 6, "list->")) st = 6;
+    if (!name.compare(st, 10, "bytevector")) return HOMO_U8;
+    return HomoKind(homo_kind_of_tag(name.c_str() + st,
+                                    name.find("vector", st) - st));
+}
+
+/** Get `obj` as the kind of homogeneous vector the builtin works on */
+static HomoVecObj *to_homovec(EvalObj *obj, const string &name) {
+    HomoKind kind = homo_kind_of_name(name);
+    if (!(obj->get_otype() & CLS_HOMO_OBJ) ||
+            static_cast<HomoVecObj*>(obj)->get_kind() != kind)
+    {
+        if (kind == HOMO_U8)
+            throw TokenError("a bytevector", RUN_ERR_WRONG_TYPE);
+        throw TokenError(string(kind <= HOMO_U64 && !(kind & 1) ? "a " : "an ") +
+                        HOMO_TAG[kind] + "vector", RUN_ERR_WRONG_TYPE);
+    }
+    return static_cast<HomoVecObj*>(obj);
+}
+
+BUILTIN_PROC_DEF(make_homovec) {
+    ARGS_AT_LEAST_ONE;
+    size_t len = to_index(args->car);
+    EvalObj *fill = NULL;
+    args = TO_PAIR(args->cdr);
+    if (args != empty_list)
+    {
+        if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
+        fill = args->car;
+    }
+    HomoVecObj *res = new HomoVecObj(homo_kind_of_name(name), len);
+    try
+    {
+        if (fill) res->fill(fill);
+    }
+    catch (GeneralError &e)
+    {
+        delete res;
+        throw;
+    }
+    return res;
+}
+
+/** Make a homogeneous vector of `kind` from the elements of `lst` */
+static HomoVecObj *homovec_from_list(EvalObj *lst, HomoKind kind) {
+    size_t len = 0;
+    EvalObj *ptr;
+    for (ptr = lst; ptr->is_pair_obj() && ptr != empty_list;
+            ptr = TO_PAIR(ptr)->cdr)
+        len++;
+    if (ptr != empty_list)
+        throw TokenError("a list", RUN_ERR_WRONG_TYPE);
+    HomoVecObj *res = new HomoVecObj(kind, len);
+    try
+    {
+        for (size_t i = 0; i < len; i++, lst = TO_PAIR(lst)->cdr)
+            res->set(i, TO_PAIR(lst)->car);
+    }
+    catch (GeneralError &e)
+    {
+        delete res;
+        throw;
+    }
+    return res;
+}
+
+BUILTIN_PROC_DEF(list_to_homovec) {
+    ARGS_EXACTLY_ONE;
+    return homovec_from_list(args->car, homo_kind_of_name(name));
+}
+
+BUILTIN_PROC_DEF(homovec) {
+    return homovec_from_list(args, homo_kind_of_name(name));
+}
+
+BUILTIN_PROC_DEF(is_homovec) {
+    ARGS_EXACTLY_ONE;
+    return new BoolObj((args->car->get_otype() & CLS_HOMO_OBJ) &&
+                        static_cast<HomoVecObj*>(args->car)->get_kind() ==
+                        homo_kind_of_name(name));
+}
+
+BUILTIN_PROC_DEF(homovec_length) {
+    ARGS_EXACTLY_ONE;
+    return new IntNumObj(to_homovec(args->car, name)->get_size());
+}
+
+BUILTIN_PROC_DEF(homovec_ref) {
+    ARGS_EXACTLY_TWO;
+    HomoVecObj *vec = to_homovec(args->car, name);
+    return vec->get(to_index(TO_PAIR(args->cdr)->car));
+}
+
+BUILTIN_PROC_DEF(homovec_set) {
+    if (args == empty_list ||
+            args->cdr == empty_list ||
+            TO_PAIR(args->cdr)->cdr == empty_list ||
+            TO_PAIR(TO_PAIR(args->cdr)->cdr)->cdr != empty_list)
+        EXC_WRONG_ARG_NUM;
+    HomoVecObj *vec = to_homovec(args->car, name);
+    args = TO_PAIR(args->cdr);
+    vec->set(to_index(args->car), TO_PAIR(args->cdr)->car);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(homovec_fill) {
+    ARGS_EXACTLY_TWO;
+    to_homovec(args->car, name)->fill(TO_PAIR(args->cdr)->car);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(homovec_to_list) {
+    ARGS_EXACTLY_ONE;
+    HomoVecObj *vec = to_homovec(args->car, name);
+    Pair *res = empty_list;
+    for (size_t i = vec->get_size(); i > 0; i--)
+        res = new Pair(vec->get(i - 1), res);
+    return res;
+}
+
+/** Get the two operands, of the same size, of a bulk operation */
+static void homovec_operands(Pair *args, HomoVecObj *&a, HomoVecObj *&b,
+                            const string &name) {
+    ARGS_EXACTLY_TWO;
+    a = to_homovec(args->car, name);
+    b = to_homovec(TO_PAIR(args->cdr)->car, name);
+    if (a->get_size() != b->get_size())
+        throw TokenError("vectors of the same length", RUN_ERR_WRONG_TYPE);
+}
+
+BUILTIN_PROC_DEF(homovec_add) {
+    HomoVecObj *a, *b;
+    homovec_operands(args, a, b, name);
+    return homo_add(a, b);
+}
+
+BUILTIN_PROC_DEF(homovec_mul) {
+    HomoVecObj *a, *b;
+    homovec_operands(args, a, b, name);
+    return homo_mul(a, b);
+}
+
+BUILTIN_PROC_DEF(homovec_dot) {
+    HomoVecObj *a, *b;
+    homovec_operands(args, a, b, name);
+    return new RealNumObj(homo_dot(a, b));
+}
+
+BUILTIN_PROC_DEF(homovec_scale) {
+    ARGS_EXACTLY_TWO;
+    HomoVecObj *vec = to_homovec(args->car, name);
+    EvalObj *k = TO_PAIR(args->cdr)->car;
+    CHECK_NUMBER(k);
+    return homo_scale(vec, num_to_double(static_cast<NumObj*>(k)));
+}
+
+BUILTIN_PROC_DEF(homovec_sum) {
+    ARGS_EXACTLY_ONE;
+    return new RealNumObj(homo_sum(to_homovec(args->car, name)));
+}
+
+BUILTIN_PROC_DEF(homovec_min) {
+    ARGS_EXACTLY_ONE;
+    HomoVecObj *vec = to_homovec(args->car, name);
+    if (!vec->get_size())
+        throw TokenError("a non-empty vector", RUN_ERR_WRONG_TYPE);
+    return new RealNumObj(homo_min(vec));
+}
+
+BUILTIN_PROC_DEF(homovec_max) {
+    ARGS_EXACTLY_ONE;
+    HomoVecObj *vec = to_homovec(args->car, name);
+    if (!vec->get_size())
+        throw TokenError("a non-empty vector", RUN_ERR_WRONG_TYPE);
+    return new RealNumObj(homo_max(vec));
+}
+
+BUILTIN_PROC_DEF(bytevector_copy) {
+    ARGS_AT_LEAST_ONE;
+    HomoVecObj *bv = to_homovec(args->car, name);
+    size_t st, ed;
+    get_range(TO_PAIR(args->cdr), bv->get_size(), st, ed, name);
+    return new HomoVecObj(HOMO_U8, bv->data.substr(st, ed - st));
+}
+
+BUILTIN_PROC_DEF(bytevector_copy_to) {
+    // (bytevector-copy! to at from [start [end]])
+    if (args == empty_list ||
+            args->cdr == empty_list ||
+            TO_PAIR(args->cdr)->cdr == empty_list)
+        EXC_WRONG_ARG_NUM;
+    HomoVecObj *to = to_homovec(args->car, name);
+    args = TO_PAIR(args->cdr);
+    size_t at = to_index(args->car);
+    args = TO_PAIR(args->cdr);
+    HomoVecObj *from = to_homovec(args->car, name);
+    size_t st, ed;
+    get_range(TO_PAIR(args->cdr), from->get_size(), st, ed, name);
+    if (at > to->get_size() || ed - st > to->get_size() - at)
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    // the ranges may overlap when copying within a bytevector
+    memmove(&to->data[at], &from->data[st], ed - st);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(bytevector_append) {
+    size_t len = 0;
+    for (Pair *ptr = args; ptr != empty_list; ptr = TO_PAIR(ptr->cdr))
+        len += to_homovec(ptr->car, name)->data.length();
+    HomoVecObj *res = new HomoVecObj(HOMO_U8, 0);
+    res->data.reserve(len);
+    for (Pair *ptr = args; ptr != empty_list; ptr = TO_PAIR(ptr->cdr))
+        res->data += static_cast<HomoVecObj*>(ptr->car)->data;
+    return res;
+}
+
+BUILTIN_PROC_DEF(utf8_to_string) {
+    ARGS_AT_LEAST_ONE;
+    HomoVecObj *bv = to_homovec(args->car, "bytevector");
+    size_t st, ed;
+    get_range(TO_PAIR(args->cdr), bv->get_size(), st, ed, name);
+    // a bytevector owns its bytes and may be changed in place, so the
+    // string gets a copy rather than a view
+    return new StrObj(bv->data.substr(st, ed - st));
+}
+
+BUILTIN_PROC_DEF(string_to_utf8) {
+    ARGS_AT_LEAST_ONE;
+    if (!args->car->is_str_obj())
+        throw TokenError("a string", RUN_ERR_WRONG_TYPE);
+    StrObj *str = static_cast<StrObj*>(args->car);
+    size_t st, ed;
+    get_range(TO_PAIR(args->cdr), str->length(), st, ed, name);
+    return new HomoVecObj(HOMO_U8, string(str->data() + st, ed - st));
+}
+
+/** Get the element kind of a binary accessor by its name, as in
+ * `bytevector-u32-ref` and `bytevector-ieee-double-native-set!`
+ * @param native set to true if no endianness argument is taken */
+static HomoKind bytevector_kind_of_name(const string &name, bool &native) {
+    size_t st = 11;     // after "bytevector-"
+    size_t ed = name.rfind('-');
+    native = !name.compare(ed - 7, 7, "-native");
+    if (native) ed -= 7;
+    if (!name.compare(st, ed - st, "ieee-single")) return HOMO_F32;
+    if (!name.compare(st, ed - st, "ieee-double")) return HOMO_F64;
+    HomoKind kind = HomoKind(homo_kind_of_tag(name.c_str() + st, ed - st));
+    if (HOMO_ELEM_SIZE[kind] == 1) native = true;
+    return kind;
+}
+
+/** Get the arguments of a binary accessor: the bytevector, the position
+ * of an element of `esize` bytes, and `nval` more values, followed by the
+ * endianness unless the accessor is `native`
+ * @param swap set to true if the bytes of the element are to be reversed */
+static HomoVecObj *bytevector_args(Pair *args, size_t esize, size_t nval,
+                                    bool native, size_t &k, EvalObj **val,
+                                    bool &swap, const string &name) {
+    EvalObj *argv[4];
+    size_t argc = 0, need = 2 + nval + !native;
+    for (; args != empty_list; args = TO_PAIR(args->cdr))
+    {
+        if (argc == need) EXC_WRONG_ARG_NUM;
+        argv[argc++] = args->car;
+    }
+    if (argc != need) EXC_WRONG_ARG_NUM;
+    HomoVecObj *bv = to_homovec(argv[0], "bytevector");
+    k = to_index(argv[1]);
+    if (k > bv->get_size() || esize > bv->get_size() - k)
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    if (nval) *val = argv[2];
+    swap = false;
+    if (native) return bv;
+    CHECK_SYMBOL(argv[need - 1]);
+    const string &order = static_cast<SymObj*>(argv[need - 1])->val;
+    if (order != "big" && order != "little")
+        throw TokenError("an endianness (big or little)", RUN_ERR_WRONG_TYPE);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    swap = order == "big";
+#else
+    swap = order == "little";
+#endif
+    return bv;
+}
+
+BUILTIN_PROC_DEF(bytevector_ref) {
+    bool native, swap;
+    size_t k;
+    HomoKind kind = bytevector_kind_of_name(name, native);
+    size_t esize = HOMO_ELEM_SIZE[kind];
+    HomoVecObj *bv = bytevector_args(args, esize, 0, native, k, NULL,
+                                    swap, name);
+    char elem[8];
+    memcpy(elem, &bv->data[k], esize);
+    if (swap) std::reverse(elem, elem + esize);
+    return homo_decode(kind, elem);
+}
+
+BUILTIN_PROC_DEF(bytevector_set) {
+    bool native, swap;
+    size_t k;
+    EvalObj *val;
+    HomoKind kind = bytevector_kind_of_name(name, native);
+    size_t esize = HOMO_ELEM_SIZE[kind];
+    HomoVecObj *bv = bytevector_args(args, esize, 1, native, k, &val,
+                                    swap, name);
+    char elem[8];
+    homo_encode(kind, val, elem);
+    if (swap) std::reverse(elem, elem + esize);
+    memcpy(&bv->data[k], elem, esize);
+    return unspec_obj;
+}
+
+/** Make the result of a hash procedure, reduced by the optional bound */
+static EvalObj *hash_result(size_t h, Pair *args, const string &name) {
+    if (args->cdr != empty_list)
+    {
+        args = TO_PAIR(args->cdr);
+        if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
+        size_t bound = to_index(args->car);
+        if (!bound)
+            throw TokenError("a positive integer", RUN_ERR_WRONG_TYPE);
+        h %= bound;
+    }
+#ifdef GMP_SUPPORT
+    return new IntNumObj(mpz_class((unsigned long)h));
+#else
+    return new IntNumObj(int(h & INT_MAX));
+#endif
+}
+
+BUILTIN_PROC_DEF(equal_hash) {
+    ARGS_AT_LEAST_ONE;
+    return hash_result(equal_hash(args->car), args, name);
+}
+
+BUILTIN_PROC_DEF(eqv_hash) {
+    ARGS_AT_LEAST_ONE;
+    return hash_result(eqv_hash(args->car), args, name);
+}
+
+BUILTIN_PROC_DEF(string_hash) {
+    ARGS_AT_LEAST_ONE;
+    if (!args->car->is_str_obj())
+        throw TokenError("a string", RUN_ERR_WRONG_TYPE);
+    StrObj *str = static_cast<StrObj*>(args->car);
+    return hash_result(string_hash(str->data(), str->length()), args, name);
+}
+
+BUILTIN_PROC_DEF(string_ci_hash) {
+    ARGS_AT_LEAST_ONE;
+    if (!args->car->is_str_obj())
+        throw TokenError("a string", RUN_ERR_WRONG_TYPE);
+    string str = static_cast<StrObj*>(args->car)->get_str();
+    for (size_t i = 0; i < str.length(); i++)
+        str[i] = tolower(str[i]);
+    return hash_result(string_hash(str), args, name);
+}
+
 BUILTIN_PROC_DEF(gc_status) {
     if (args != empty_list) EXC_WRONG_ARG_NUM;
     return new IntNumObj(gc.get_remaining());
@@ -1597,9 +3473,280 @@ BUILTIN_PROC_DEF(set_gc_resolve_threshold) {
     return new UnspecObj();
 }
 
+/** Check and convert an output port argument */
+static OutPortObj *to_out_port(EvalObj *obj) {
+    if (!(obj->get_otype() & CLS_OUT_PORT))
+        throw TokenError("an output port", RUN_ERR_WRONG_TYPE);
+    return static_cast<OutPortObj*>(obj);
+}
+
+/** Get the optional port argument of an output procedure */
+static OutPortObj *opt_out_port(Pair *args, const string &name) {
+    if (args == empty_list) return cur_out_port;
+    if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
+    return to_out_port(args->car);
+}
+
 BUILTIN_PROC_DEF(display) {
+    ARGS_AT_LEAST_ONE;
+    OutPortObj *port = opt_out_port(TO_PAIR(args->cdr), name);
+    args->car->write_repr(*port);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(write) {
+    ARGS_AT_LEAST_ONE;
+    OutPortObj *port = opt_out_port(TO_PAIR(args->cdr), name);
+    args->car->write_repr(*port, true);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(write_string) {
+    ARGS_AT_LEAST_ONE;
+    if (!args->car->is_str_obj())
+        throw TokenError("a string", RUN_ERR_WRONG_TYPE);
+    OutPortObj *port = opt_out_port(TO_PAIR(args->cdr), name);
+    StrObj *str = static_cast<StrObj*>(args->car);
+    port->write(str->data(), str->length());
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(write_bytevector) {
+    // (write-bytevector bv [port [start [end]]])
+    ARGS_AT_LEAST_ONE;
+    HomoVecObj *bv = to_homovec(args->car, "bytevector");
+    args = TO_PAIR(args->cdr);
+    OutPortObj *port = cur_out_port;
+    size_t st = 0, ed = bv->get_size();
+    if (args != empty_list)
+    {
+        port = to_out_port(args->car);
+        get_range(TO_PAIR(args->cdr), bv->get_size(), st, ed, name);
+    }
+    port->write(bv->data.data() + st, ed - st);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(write_char) {
+    ARGS_AT_LEAST_ONE;
+    if (!(args->car->get_otype() & CLS_CHAR_OBJ))
+        throw TokenError("a character", RUN_ERR_WRONG_TYPE);
+    OutPortObj *port = opt_out_port(TO_PAIR(args->cdr), name);
+    port->put(static_cast<CharObj*>(args->car)->ch);
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(newline) {
+    opt_out_port(args, name)->put('\n');
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(flush_output_port) {
+    opt_out_port(args, name)->flush();
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(current_output_port) {
+    if (args != empty_list) EXC_WRONG_ARG_NUM;
+    return cur_out_port;
+}
+
+BUILTIN_PROC_DEF(set_port_buffering) {
+    ARGS_EXACTLY_TWO;
+    OutPortObj *port = to_out_port(args->car);
+    EvalObj *mode = TO_PAIR(args->cdr)->car;
+    CHECK_SYMBOL(mode);
+    const string &mname = static_cast<SymObj*>(mode)->val;
+    if (mname == "none") port->set_mode(BUF_NONE);
+    else if (mname == "line") port->set_mode(BUF_LINE);
+    else if (mname == "full") port->set_mode(BUF_FULL);
+    else throw TokenError("none, line or full", RUN_ERR_WRONG_TYPE);
+    return unspec_obj;
+}
+
+/** Check and convert an input port argument */
+static InPortObj *to_in_port(EvalObj *obj) {
+    if (!(obj->get_otype() & CLS_IN_PORT))
+        throw TokenError("an input port", RUN_ERR_WRONG_TYPE);
+    return static_cast<InPortObj*>(obj);
+}
+
+/** Get the optional port argument of an input procedure */
+static InPortObj *opt_in_port(Pair *args, const string &name) {
+    if (args == empty_list) return get_stdin_port();
+    if (args->cdr != empty_list) EXC_WRONG_ARG_NUM;
+    return to_in_port(args->car);
+}
+
+/** Get the shared character object, so that reading characters does not
+ * allocate */
+static EvalObj *char_obj(int ch) {
+    static CharObj *char_table[256];
+    if (ch == EOF) return eof_obj;
+    CharObj *&res = char_table[(unsigned char)ch];
+    if (!res) gc.attach(res = new CharObj(ch));
+    return res;
+}
+
+BUILTIN_PROC_DEF(open_input_file) {
+    ARGS_EXACTLY_ONE;
+    if (!args->car->is_str_obj())
+        throw TokenError("a string", RUN_ERR_WRONG_TYPE);
+    string fname = static_cast<StrObj*>(args->car)->get_str();
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw TokenError(fname, RUN_ERR_FILE_OPEN);
+    return new InPortObj(fd);
+}
+
+BUILTIN_PROC_DEF(close_input_port) {
     ARGS_EXACTLY_ONE;
-    printf("%s", args->car->ext_repr().c_str());
-    fflush(stdout);
+    to_in_port(args->car)->close();
     return unspec_obj;
 }
+
+BUILTIN_PROC_DEF(current_input_port) {
+    if (args != empty_list) EXC_WRONG_ARG_NUM;
+    return get_stdin_port();
+}
+
+BUILTIN_PROC_DEF(read_char) {
+    return char_obj(opt_in_port(args, name)->read_char());
+}
+
+BUILTIN_PROC_DEF(peek_char) {
+    return char_obj(opt_in_port(args, name)->peek_char());
+}
+
+BUILTIN_PROC_DEF(read_line) {
+    InPortObj *port = opt_in_port(args, name);
+    string line;
+    if (!port->read_line(line)) return eof_obj;
+    return new StrObj(line);
+}
+
+BUILTIN_PROC_DEF(read_string) {
+    ARGS_AT_LEAST_ONE;
+    size_t len = to_index(args->car);
+    InPortObj *port = opt_in_port(TO_PAIR(args->cdr), name);
+    string res;
+    if (!port->read_string(res, len)) return eof_obj;
+    return new StrObj(res);
+}
+
+BUILTIN_PROC_DEF(read_bytevector) {
+    ARGS_AT_LEAST_ONE;
+    size_t len = to_index(args->car);
+    InPortObj *port = opt_in_port(TO_PAIR(args->cdr), name);
+    HomoVecObj *res = new HomoVecObj(HOMO_U8, 0);
+    // read directly into the storage of the bytevector
+    if (!port->read_string(res->data, len))
+    {
+        delete res;
+        return eof_obj;
+    }
+    return res;
+}
+
+BUILTIN_PROC_DEF(read) {
+    // shared by all ports, the position is handed back after each datum
+    static Tokenizor tk;
+    static ASTGenerator ast;
+    InPortObj *port = opt_in_port(args, name);
+    if (port->ptr == port->end && !port->refill())
+        return eof_obj;
+    Pair *tree;
+    tk.set_port(port);
+    try
+    {
+        tree = ast.absorb(&tk);
+    }
+    catch (GeneralError &e)
+    {
+        tk.release_port();
+        throw;
+    }
+    tk.release_port();
+    if (!tree) return eof_obj;
+    // the datum is kept by the caller before the wrapper is recycled
+    gc.attach(tree);
+    gc.expose(tree);
+    return tree->car;
+}
+
+BUILTIN_PROC_DEF(open_output_file) {
+    ARGS_EXACTLY_ONE;
+    if (!args->car->is_str_obj())
+        throw TokenError("a string", RUN_ERR_WRONG_TYPE);
+    string fname = static_cast<StrObj*>(args->car)->get_str();
+    int fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        throw TokenError(fname, RUN_ERR_FILE_OPEN);
+    return new OutPortObj(fd, BUF_FULL, true);
+}
+
+BUILTIN_PROC_DEF(open_output_string) {
+    if (args != empty_list) EXC_WRONG_ARG_NUM;
+    return new StrOutPortObj();
+}
+
+/** Check and convert a string port argument */
+static StrOutPortObj *to_str_port(EvalObj *obj) {
+    if (!(obj->get_otype() & CLS_STR_PORT))
+        throw TokenError("a string port", RUN_ERR_WRONG_TYPE);
+    return static_cast<StrOutPortObj*>(obj);
+}
+
+BUILTIN_PROC_DEF(get_output_string) {
+    ARGS_EXACTLY_ONE;
+    return new StrObj(to_str_port(args->car)->text);
+}
+
+BUILTIN_PROC_DEF(string_builder_append) {
+    // (string-builder-append! builder obj ...), characters and strings are
+    // appended as they are, other objects as `display` writes them
+    ARGS_AT_LEAST_ONE;
+    StrOutPortObj *port = to_str_port(args->car);
+    for (args = TO_PAIR(args->cdr); args != empty_list;
+            args = TO_PAIR(args->cdr))
+    {
+        EvalObj *obj = args->car;
+        if (obj->get_otype() & CLS_CHAR_OBJ)
+            port->put(static_cast<CharObj*>(obj)->ch);
+        else
+            obj->write_repr(*port);
+    }
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(close_output_port) {
+    ARGS_EXACTLY_ONE;
+    to_out_port(args->car)->close();
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(serialize) {
+    ARGS_AT_LEAST_ONE;
+    OutPortObj *port = opt_out_port(TO_PAIR(args->cdr), name);
+    // nothing is written if the value can not be serialized
+    string buff;
+    StringSink out(buff);
+    serialize(args->car, out);
+    port->write(buff.data(), buff.length());
+    return unspec_obj;
+}
+
+BUILTIN_PROC_DEF(deserialize) {
+    EvalObj *res = deserialize(opt_in_port(args, name));
+    return res ? res : eof_obj;
+}
+
+BUILTIN_PROC_DEF(eof_object) {
+    if (args != empty_list) EXC_WRONG_ARG_NUM;
+    return eof_obj;
+}
+
+BUILTIN_PROC_DEF(is_eof_object) {
+    ARGS_EXACTLY_ONE;
+    return new BoolObj(args->car == eof_obj);
+}
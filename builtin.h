@@ -8,7 +8,11 @@
 
 using std::string;
 
-const int EQUAL_QUEUE_SIZE = 262144;
+/** `equal?` compares containers in rounds: the first EQUAL_FAST_LIMIT ones
+ * of each round are not tracked, the following EQUAL_TRACK_LIMIT ones are
+ * tracked for cycles */
+const size_t EQUAL_FAST_LIMIT = 1024;
+const size_t EQUAL_TRACK_LIMIT = 128;
 
 /** @class SpecialOptIf
  * The implementation of `if` operator
@@ -55,6 +59,21 @@ class SpecialOptDefine: public SpecialOptObj {/*{{{*/
                 Continuation * &cont, EvalObj ** &top_ptr, Pair *pc);
 };/*}}}*/
 
+/** @class SpecialOptDefineRecord
+ * The implementation of `define-record-type` operator
+ */
+class SpecialOptDefineRecord: public SpecialOptObj {/*{{{*/
+    public:
+        /** Construct a `define-record-type` operator */
+        SpecialOptDefineRecord();
+        /** Prevent the whole definition from being evaluated */
+        void prepare(Pair *pc);
+        /** Bind the type, its constructor, predicate, accessors and
+         * modifiers */
+        Pair *call(Pair *args, Environment * &envt,
+                Continuation * &cont, EvalObj ** &top_ptr, Pair *pc);
+};/*}}}*/
+
 /** @class SpecialOptSet
  * The implementation of `set!` operator
  */
@@ -176,6 +195,158 @@ class SpecialOptForce: public SpecialOptObj {/*{{{*/
 
 };/*}}}*/
 
+/** @class SpecialOptCaller
+ * The base of the operators which call procedures and go on with their
+ * results. The state between the calls is kept in the evaluation stack.
+ */
+class SpecialOptCaller: public SpecialOptObj {/*{{{*/
+    public:
+        /** Construct an operator named `name` */
+        SpecialOptCaller(string name);
+        /** Do a step of the operation
+         * @param state the arguments at the first step, or what is kept by
+         * the last step
+         * @param res the result of the last call, NULL at the first step
+         * @param keep the state to be kept for the next step
+         * @param call the procedure to be called and its arguments
+         * @return the final result, or NULL to make the call */
+        virtual EvalObj *step(EvalObjVec &state, EvalObj *res,
+                            EvalObjVec &keep, EvalObjVec &call) = 0;
+        /** Run the steps, making the calls in between */
+        Pair *call(Pair *args, Environment * &envt,
+                Continuation * &cont, EvalObj ** &top_ptr, Pair *pc);
+};/*}}}*/
+
+/** @class SpecialOptHashUpdate
+ * The implementation of `hash-table-update!` and
+ * `hash-table-update!/default` operators
+ */
+class SpecialOptHashUpdate: public SpecialOptCaller {/*{{{*/
+    private:
+        /** The fourth argument is a default value instead of a thunk */
+        bool def_val;
+    public:
+        /** Construct the `/default` variant if `def_val` is set */
+        SpecialOptHashUpdate(bool def_val);
+        /** Call the procedure with the old value and store the result */
+        EvalObj *step(EvalObjVec &state, EvalObj *res,
+                    EvalObjVec &keep, EvalObjVec &call);
+};/*}}}*/
+
+/** @class SpecialOptHashFold
+ * The implementation of `hash-table-fold` and `hash-table-walk` operators
+ */
+class SpecialOptHashFold: public SpecialOptCaller {/*{{{*/
+    private:
+        /** Only visit the entries, without an accumulated value */
+        bool walk;
+    public:
+        /** Construct `hash-table-walk` if `walk` is set */
+        SpecialOptHashFold(bool walk);
+        /** Call the procedure with every key and value */
+        EvalObj *step(EvalObjVec &state, EvalObj *res,
+                    EvalObjVec &keep, EvalObjVec &call);
+};/*}}}*/
+
+/** @class SpecialOptMap
+ * The implementation of `map` and `for-each` operators
+ */
+class SpecialOptMap: public SpecialOptCaller {/*{{{*/
+    private:
+        /** Only visit the elements, without collecting the results */
+        bool for_each;
+    public:
+        /** Construct `for-each` if `for_each` is set */
+        SpecialOptMap(bool for_each);
+        /** Call the procedure with the elements at every position */
+        EvalObj *step(EvalObjVec &state, EvalObj *res,
+                    EvalObjVec &keep, EvalObjVec &call);
+};/*}}}*/
+
+/** The order in which the fold operators visit elements and pass the
+ * accumulated value */
+enum FoldOrder {
+    FOLD,           /**< `fold`: left to right, (proc elem ... acc) */
+    FOLD_LEFT,      /**< `fold-left`: left to right, (proc acc elem ...) */
+    FOLD_RIGHT      /**< `fold-right`: right to left, (proc elem ... acc) */
+};
+
+/** @class SpecialOptFold
+ * The implementation of `fold`, `fold-left` and `fold-right` operators
+ */
+class SpecialOptFold: public SpecialOptCaller {/*{{{*/
+    private:
+        FoldOrder order;
+    public:
+        /** Construct the operator of `order` */
+        SpecialOptFold(FoldOrder order);
+        /** Call the procedure with the elements at every position and the
+         * accumulated value */
+        EvalObj *step(EvalObjVec &state, EvalObj *res,
+                    EvalObjVec &keep, EvalObjVec &call);
+};/*}}}*/
+
+/** @class SpecialOptFilter
+ * The implementation of `filter` and `remove` operators
+ */
+class SpecialOptFilter: public SpecialOptCaller {/*{{{*/
+    private:
+        /** Keep the elements failing the predicate instead */
+        bool remove;
+    public:
+        /** Construct `remove` if `remove` is set */
+        SpecialOptFilter(bool remove);
+        /** Test every element with the predicate */
+        EvalObj *step(EvalObjVec &state, EvalObj *res,
+                    EvalObjVec &keep, EvalObjVec &call);
+};/*}}}*/
+
+/** @class SpecialOptVectorMap
+ * The implementation of `vector-map` and `vector-for-each` operators
+ */
+class SpecialOptVectorMap: public SpecialOptCaller {/*{{{*/
+    private:
+        /** Only visit the elements, without collecting the results */
+        bool for_each;
+    public:
+        /** Construct `vector-for-each` if `for_each` is set */
+        SpecialOptVectorMap(bool for_each);
+        /** Call the procedure with the elements at every position */
+        EvalObj *step(EvalObjVec &state, EvalObj *res,
+                    EvalObjVec &keep, EvalObjVec &call);
+};/*}}}*/
+
+/** The sequences the sort operators take and make */
+enum SortMode {
+    SORT_SEQ,               /**< `sort`: (sort seq less?), a new list or
+                              vector as `seq` is */
+    SORT_LIST,              /**< `list-sort`: (list-sort less? list) */
+    SORT_VECTOR,            /**< `vector-sort`: (vector-sort less? vector) */
+    SORT_VECTOR_INPLACE,    /**< `vector-sort!`: (vector-sort! less? vector) */
+    SORT_MERGE              /**< `merge`: (merge list1 list2 less?) */
+};
+
+/** @class SpecialOptSort
+ * The implementation of `sort`, `list-sort`, `vector-sort`, `vector-sort!`
+ * and `merge` operators, by a stable bottom-up merge sort
+ */
+class SpecialOptSort: public SpecialOptCaller {/*{{{*/
+    private:
+        SortMode mode;
+    public:
+        /** Construct the operator of `mode` */
+        SpecialOptSort(SortMode mode);
+        /** Call the predicate to compare the heads of the runs being
+         * merged */
+        EvalObj *step(EvalObjVec &state, EvalObj *res,
+                    EvalObjVec &keep, EvalObjVec &call);
+};/*}}}*/
+
+/** Test the equivalence of two objects as `eqv?` does */
+bool is_eqv_obj(EvalObj *obj1, EvalObj *obj2);
+/** Test the equivalence of two objects as `equal?` does */
+bool is_equal_obj(EvalObj *obj1, EvalObj *obj2);
+
 /* The following lines are the implementation of various simple built-in
  * procedures. Some library procdures are implemented here for the sake of
  * efficiency. */
@@ -208,6 +379,43 @@ BUILTIN_PROC_DEF(num_quo);
 BUILTIN_PROC_DEF(num_gcd);
 BUILTIN_PROC_DEF(num_lcm);
 
+BUILTIN_PROC_DEF(is_flonum);
+BUILTIN_PROC_DEF(is_fixnum);
+BUILTIN_PROC_DEF(fl_add);
+BUILTIN_PROC_DEF(fl_sub);
+BUILTIN_PROC_DEF(fl_mul);
+BUILTIN_PROC_DEF(fl_div);
+BUILTIN_PROC_DEF(fl_lt);
+BUILTIN_PROC_DEF(fl_le);
+BUILTIN_PROC_DEF(fl_gt);
+BUILTIN_PROC_DEF(fl_ge);
+BUILTIN_PROC_DEF(fl_eq);
+BUILTIN_PROC_DEF(fl_abs);
+BUILTIN_PROC_DEF(fl_sqrt);
+BUILTIN_PROC_DEF(fl_exp);
+BUILTIN_PROC_DEF(fl_log);
+BUILTIN_PROC_DEF(fl_sin);
+BUILTIN_PROC_DEF(fl_cos);
+BUILTIN_PROC_DEF(fl_tan);
+BUILTIN_PROC_DEF(fl_asin);
+BUILTIN_PROC_DEF(fl_acos);
+BUILTIN_PROC_DEF(fl_atan);
+BUILTIN_PROC_DEF(fl_floor);
+BUILTIN_PROC_DEF(fl_ceiling);
+BUILTIN_PROC_DEF(fl_round);
+BUILTIN_PROC_DEF(fl_truncate);
+BUILTIN_PROC_DEF(fx_add);
+BUILTIN_PROC_DEF(fx_sub);
+BUILTIN_PROC_DEF(fx_mul);
+BUILTIN_PROC_DEF(fx_quo);
+BUILTIN_PROC_DEF(fx_rem);
+BUILTIN_PROC_DEF(fx_abs);
+BUILTIN_PROC_DEF(fx_lt);
+BUILTIN_PROC_DEF(fx_le);
+BUILTIN_PROC_DEF(fx_gt);
+BUILTIN_PROC_DEF(fx_ge);
+BUILTIN_PROC_DEF(fx_eq);
+
 BUILTIN_PROC_DEF(bool_not);
 BUILTIN_PROC_DEF(is_boolean);
 
@@ -229,6 +437,30 @@ BUILTIN_PROC_DEF(is_eqv);
 BUILTIN_PROC_DEF(is_equal);
 
 BUILTIN_PROC_DEF(display);
+BUILTIN_PROC_DEF(write);
+BUILTIN_PROC_DEF(write_string);
+BUILTIN_PROC_DEF(write_char);
+BUILTIN_PROC_DEF(newline);
+BUILTIN_PROC_DEF(flush_output_port);
+BUILTIN_PROC_DEF(current_output_port);
+BUILTIN_PROC_DEF(set_port_buffering);
+BUILTIN_PROC_DEF(open_input_file);
+BUILTIN_PROC_DEF(close_input_port);
+BUILTIN_PROC_DEF(current_input_port);
+BUILTIN_PROC_DEF(read_char);
+BUILTIN_PROC_DEF(peek_char);
+BUILTIN_PROC_DEF(read_line);
+BUILTIN_PROC_DEF(read_string);
+BUILTIN_PROC_DEF(read);
+BUILTIN_PROC_DEF(open_output_file);
+BUILTIN_PROC_DEF(open_output_string);
+BUILTIN_PROC_DEF(get_output_string);
+BUILTIN_PROC_DEF(string_builder_append);
+BUILTIN_PROC_DEF(close_output_port);
+BUILTIN_PROC_DEF(serialize);
+BUILTIN_PROC_DEF(deserialize);
+BUILTIN_PROC_DEF(eof_object);
+BUILTIN_PROC_DEF(is_eof_object);
 BUILTIN_PROC_DEF(is_string);
 BUILTIN_PROC_DEF(is_symbol);
 BUILTIN_PROC_DEF(string_lt);
@@ -236,11 +468,85 @@ BUILTIN_PROC_DEF(string_le);
 BUILTIN_PROC_DEF(string_gt);
 BUILTIN_PROC_DEF(string_ge);
 BUILTIN_PROC_DEF(string_eq);
+BUILTIN_PROC_DEF(string_ci_cmp);
+BUILTIN_PROC_DEF(make_string);
+BUILTIN_PROC_DEF(string_of_chars);
+BUILTIN_PROC_DEF(string_length);
+BUILTIN_PROC_DEF(string_ref);
+BUILTIN_PROC_DEF(string_set);
+BUILTIN_PROC_DEF(substring);
+BUILTIN_PROC_DEF(string_append);
+BUILTIN_PROC_DEF(string_to_list);
+BUILTIN_PROC_DEF(list_to_string);
+BUILTIN_PROC_DEF(string_fill);
+BUILTIN_PROC_DEF(string_search_forward);
+BUILTIN_PROC_DEF(string_contains);
+BUILTIN_PROC_DEF(string_index);
+BUILTIN_PROC_DEF(string_split);
+BUILTIN_PROC_DEF(string_prefix);
+BUILTIN_PROC_DEF(number_to_string);
+BUILTIN_PROC_DEF(string_to_number);
+BUILTIN_PROC_DEF(symbol_to_string);
+BUILTIN_PROC_DEF(string_to_symbol);
 
 BUILTIN_PROC_DEF(make_vector);
 BUILTIN_PROC_DEF(vector_set);
 BUILTIN_PROC_DEF(vector_ref);
 BUILTIN_PROC_DEF(vector_length);
+BUILTIN_PROC_DEF(vector);
+BUILTIN_PROC_DEF(vector_fill);
+BUILTIN_PROC_DEF(vector_copy);
+BUILTIN_PROC_DEF(vector_copy_to);
+BUILTIN_PROC_DEF(vector_grow);
+BUILTIN_PROC_DEF(vector_to_list);
+BUILTIN_PROC_DEF(list_to_vector);
+
+BUILTIN_PROC_DEF(make_hash_table);
+BUILTIN_PROC_DEF(make_weak_hash_table);
+BUILTIN_PROC_DEF(is_hash_table);
+BUILTIN_PROC_DEF(hash_table_ref);
+BUILTIN_PROC_DEF(hash_table_ref_default);
+BUILTIN_PROC_DEF(hash_table_set);
+BUILTIN_PROC_DEF(hash_table_delete);
+BUILTIN_PROC_DEF(hash_table_contains);
+BUILTIN_PROC_DEF(hash_table_count);
+BUILTIN_PROC_DEF(hash_table_keys);
+BUILTIN_PROC_DEF(hash_table_values);
+BUILTIN_PROC_DEF(hash_table_to_alist);
+BUILTIN_PROC_DEF(hash_table_clear);
+BUILTIN_PROC_DEF(memv);
+BUILTIN_PROC_DEF(member);
+BUILTIN_PROC_DEF(assv);
+BUILTIN_PROC_DEF(assoc);
+BUILTIN_PROC_DEF(make_homovec);
+BUILTIN_PROC_DEF(list_to_homovec);
+BUILTIN_PROC_DEF(homovec);
+BUILTIN_PROC_DEF(is_homovec);
+BUILTIN_PROC_DEF(homovec_length);
+BUILTIN_PROC_DEF(homovec_ref);
+BUILTIN_PROC_DEF(homovec_set);
+BUILTIN_PROC_DEF(homovec_fill);
+BUILTIN_PROC_DEF(homovec_to_list);
+BUILTIN_PROC_DEF(homovec_add);
+BUILTIN_PROC_DEF(homovec_mul);
+BUILTIN_PROC_DEF(homovec_dot);
+BUILTIN_PROC_DEF(homovec_scale);
+BUILTIN_PROC_DEF(homovec_sum);
+BUILTIN_PROC_DEF(homovec_min);
+BUILTIN_PROC_DEF(homovec_max);
+BUILTIN_PROC_DEF(bytevector_copy);
+BUILTIN_PROC_DEF(bytevector_copy_to);
+BUILTIN_PROC_DEF(bytevector_append);
+BUILTIN_PROC_DEF(utf8_to_string);
+BUILTIN_PROC_DEF(string_to_utf8);
+BUILTIN_PROC_DEF(bytevector_ref);
+BUILTIN_PROC_DEF(bytevector_set);
+BUILTIN_PROC_DEF(read_bytevector);
+BUILTIN_PROC_DEF(write_bytevector);
+BUILTIN_PROC_DEF(equal_hash);
+BUILTIN_PROC_DEF(eqv_hash);
+BUILTIN_PROC_DEF(string_hash);
+BUILTIN_PROC_DEF(string_ci_hash);
 
 BUILTIN_PROC_DEF(gc_status);
 BUILTIN_PROC_DEF(set_gc_resolve_threshold);
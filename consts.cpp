@@ -20,5 +20,9 @@ const char *ERR_MSG[] = {
     "%s stack overflowed!",
     "Numeric overflow!",
     "Value out of range",
-    "GC overflow!"
+    "GC overflow!",
+    "Can not open file: %s",
+    "Port is already closed",
+    "Malformed serialized data",
+    "Key not found in the hash table"
 };
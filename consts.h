@@ -21,7 +21,11 @@ enum ErrCode {
     RUN_ERR_STACK_OVERFLOW,
     RUN_ERR_NUMERIC_OVERFLOW,
     RUN_ERR_VALUE_OUT_OF_RANGE,
-    RUN_ERR_GC_OVERFLOW
+    RUN_ERR_GC_OVERFLOW,
+    RUN_ERR_FILE_OPEN,
+    RUN_ERR_PORT_CLOSED,
+    RUN_ERR_BAD_SERIAL,
+    RUN_ERR_KEY_NOT_FOUND
 };
 
 extern const char *ERR_MSG[];
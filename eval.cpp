@@ -3,6 +3,8 @@
 #include "builtin.h"
 #include "exc.h"
 #include "gc.h"
+#include "serialize.h"
+#include "homovec.h"
 
 #include <cstdio>
 
@@ -28,6 +30,7 @@ void Evaluator::add_builtin_routines() {
     ADD_ENTRY("if", new SpecialOptIf());
     ADD_ENTRY("lambda", new SpecialOptLambda());
     ADD_ENTRY("define", new SpecialOptDefine());
+    ADD_ENTRY("define-record-type", new SpecialOptDefineRecord());
     ADD_ENTRY("set!", new SpecialOptSet());
     ADD_ENTRY("quote", new SpecialOptQuote());
     ADD_ENTRY("eval", new SpecialOptEval());
@@ -36,6 +39,24 @@ void Evaluator::add_builtin_routines() {
     ADD_ENTRY("apply", new SpecialOptApply());
     ADD_ENTRY("delay", new SpecialOptDelay());
     ADD_ENTRY("force", new SpecialOptForce());
+    ADD_ENTRY("hash-table-update!", new SpecialOptHashUpdate(false));
+    ADD_ENTRY("hash-table-update!/default", new SpecialOptHashUpdate(true));
+    ADD_ENTRY("hash-table-fold", new SpecialOptHashFold(false));
+    ADD_ENTRY("hash-table-walk", new SpecialOptHashFold(true));
+    ADD_ENTRY("map", new SpecialOptMap(false));
+    ADD_ENTRY("for-each", new SpecialOptMap(true));
+    ADD_ENTRY("fold", new SpecialOptFold(FOLD));
+    ADD_ENTRY("fold-left", new SpecialOptFold(FOLD_LEFT));
+    ADD_ENTRY("fold-right", new SpecialOptFold(FOLD_RIGHT));
+    ADD_ENTRY("filter", new SpecialOptFilter(false));
+    ADD_ENTRY("remove", new SpecialOptFilter(true));
+    ADD_ENTRY("vector-map", new SpecialOptVectorMap(false));
+    ADD_ENTRY("vector-for-each", new SpecialOptVectorMap(true));
+    ADD_ENTRY("sort", new SpecialOptSort(SORT_SEQ));
+    ADD_ENTRY("list-sort", new SpecialOptSort(SORT_LIST));
+    ADD_ENTRY("vector-sort", new SpecialOptSort(SORT_VECTOR));
+    ADD_ENTRY("vector-sort!", new SpecialOptSort(SORT_VECTOR_INPLACE));
+    ADD_ENTRY("merge", new SpecialOptSort(SORT_MERGE));
 
     ADD_BUILTIN_PROC("+", num_add);
     ADD_BUILTIN_PROC("-", num_sub);
@@ -62,6 +83,44 @@ void Evaluator::add_builtin_routines() {
     ADD_BUILTIN_PROC("gcd", num_gcd);
     ADD_BUILTIN_PROC("lcm", num_lcm);
 
+    ADD_BUILTIN_PROC("flonum?", is_flonum);
+    ADD_BUILTIN_PROC("fl+", fl_add);
+    ADD_BUILTIN_PROC("fl-", fl_sub);
+    ADD_BUILTIN_PROC("fl*", fl_mul);
+    ADD_BUILTIN_PROC("fl/", fl_div);
+    ADD_BUILTIN_PROC("fl<", fl_lt);
+    ADD_BUILTIN_PROC("fl<=", fl_le);
+    ADD_BUILTIN_PROC("fl>", fl_gt);
+    ADD_BUILTIN_PROC("fl>=", fl_ge);
+    ADD_BUILTIN_PROC("fl=", fl_eq);
+    ADD_BUILTIN_PROC("flabs", fl_abs);
+    ADD_BUILTIN_PROC("flsqrt", fl_sqrt);
+    ADD_BUILTIN_PROC("flexp", fl_exp);
+    ADD_BUILTIN_PROC("fllog", fl_log);
+    ADD_BUILTIN_PROC("flsin", fl_sin);
+    ADD_BUILTIN_PROC("flcos", fl_cos);
+    ADD_BUILTIN_PROC("fltan", fl_tan);
+    ADD_BUILTIN_PROC("flasin", fl_asin);
+    ADD_BUILTIN_PROC("flacos", fl_acos);
+    ADD_BUILTIN_PROC("flatan", fl_atan);
+    ADD_BUILTIN_PROC("flfloor", fl_floor);
+    ADD_BUILTIN_PROC("flceiling", fl_ceiling);
+    ADD_BUILTIN_PROC("flround", fl_round);
+    ADD_BUILTIN_PROC("fltruncate", fl_truncate);
+
+    ADD_BUILTIN_PROC("fixnum?", is_fixnum);
+    ADD_BUILTIN_PROC("fx+", fx_add);
+    ADD_BUILTIN_PROC("fx-", fx_sub);
+    ADD_BUILTIN_PROC("fx*", fx_mul);
+    ADD_BUILTIN_PROC("fxquotient", fx_quo);
+    ADD_BUILTIN_PROC("fxremainder", fx_rem);
+    ADD_BUILTIN_PROC("fxabs", fx_abs);
+    ADD_BUILTIN_PROC("fx<", fx_lt);
+    ADD_BUILTIN_PROC("fx<=", fx_le);
+    ADD_BUILTIN_PROC("fx>", fx_gt);
+    ADD_BUILTIN_PROC("fx>=", fx_ge);
+    ADD_BUILTIN_PROC("fx=", fx_eq);
+
 
     ADD_BUILTIN_PROC("not", bool_not);
     ADD_BUILTIN_PROC("boolean?", is_boolean);
@@ -79,12 +138,44 @@ void Evaluator::add_builtin_routines() {
     ADD_BUILTIN_PROC("append", append);
     ADD_BUILTIN_PROC("reverse", reverse);
     ADD_BUILTIN_PROC("list-tail", list_tail);
+    ADD_BUILTIN_PROC("memq", memv);
+    ADD_BUILTIN_PROC("memv", memv);
+    ADD_BUILTIN_PROC("member", member);
+    ADD_BUILTIN_PROC("assq", assv);
+    ADD_BUILTIN_PROC("assv", assv);
+    ADD_BUILTIN_PROC("assoc", assoc);
 
     ADD_BUILTIN_PROC("eqv?", is_eqv);
     ADD_BUILTIN_PROC("eq?", is_eqv);
     ADD_BUILTIN_PROC("equal?", is_equal);
 
     ADD_BUILTIN_PROC("display", display);
+    ADD_BUILTIN_PROC("write", write);
+    ADD_BUILTIN_PROC("write-string", write_string);
+    ADD_BUILTIN_PROC("write-char", write_char);
+    ADD_BUILTIN_PROC("newline", newline);
+    ADD_BUILTIN_PROC("flush-output-port", flush_output_port);
+    ADD_BUILTIN_PROC("current-output-port", current_output_port);
+    ADD_BUILTIN_PROC("set-port-buffering!", set_port_buffering);
+    ADD_BUILTIN_PROC("open-input-file", open_input_file);
+    ADD_BUILTIN_PROC("close-input-port", close_input_port);
+    ADD_BUILTIN_PROC("current-input-port", current_input_port);
+    ADD_BUILTIN_PROC("read-char", read_char);
+    ADD_BUILTIN_PROC("peek-char", peek_char);
+    ADD_BUILTIN_PROC("read-line", read_line);
+    ADD_BUILTIN_PROC("read-string", read_string);
+    ADD_BUILTIN_PROC("read", read);
+    ADD_BUILTIN_PROC("open-output-file", open_output_file);
+    ADD_BUILTIN_PROC("close-output-port", close_output_port);
+    ADD_BUILTIN_PROC("open-output-string", open_output_string);
+    ADD_BUILTIN_PROC("get-output-string", get_output_string);
+    ADD_BUILTIN_PROC("string-builder", open_output_string);
+    ADD_BUILTIN_PROC("string-builder-append!", string_builder_append);
+    ADD_BUILTIN_PROC("string-builder->string", get_output_string);
+    ADD_BUILTIN_PROC("serialize", serialize);
+    ADD_BUILTIN_PROC("deserialize", deserialize);
+    ADD_BUILTIN_PROC("eof-object", eof_object);
+    ADD_BUILTIN_PROC("eof-object?", is_eof_object);
     ADD_BUILTIN_PROC("string?", is_string);
     ADD_BUILTIN_PROC("symbol?", is_symbol);
     ADD_BUILTIN_PROC("string<?", string_lt);
@@ -92,11 +183,113 @@ void Evaluator::add_builtin_routines() {
     ADD_BUILTIN_PROC("string>?", string_gt);
     ADD_BUILTIN_PROC("string>=?", string_ge);
     ADD_BUILTIN_PROC("string=?", string_eq);
+    ADD_BUILTIN_PROC("string-ci=?", string_ci_cmp);
+    ADD_BUILTIN_PROC("string-ci<?", string_ci_cmp);
+    ADD_BUILTIN_PROC("string-ci>?", string_ci_cmp);
+    ADD_BUILTIN_PROC("string-ci<=?", string_ci_cmp);
+    ADD_BUILTIN_PROC("string-ci>=?", string_ci_cmp);
+    ADD_BUILTIN_PROC("make-string", make_string);
+    ADD_BUILTIN_PROC("string", string_of_chars);
+    ADD_BUILTIN_PROC("string-length", string_length);
+    ADD_BUILTIN_PROC("string-ref", string_ref);
+    ADD_BUILTIN_PROC("string-set!", string_set);
+    ADD_BUILTIN_PROC("substring", substring);
+    ADD_BUILTIN_PROC("string-copy", substring);
+    ADD_BUILTIN_PROC("string-append", string_append);
+    ADD_BUILTIN_PROC("string->list", string_to_list);
+    ADD_BUILTIN_PROC("list->string", list_to_string);
+    ADD_BUILTIN_PROC("string-fill!", string_fill);
+    ADD_BUILTIN_PROC("string-search-forward", string_search_forward);
+    ADD_BUILTIN_PROC("string-contains", string_contains);
+    ADD_BUILTIN_PROC("string-index", string_index);
+    ADD_BUILTIN_PROC("string-split", string_split);
+    ADD_BUILTIN_PROC("string-prefix?", string_prefix);
+    ADD_BUILTIN_PROC("string-suffix?", string_prefix);
+    ADD_BUILTIN_PROC("number->string", number_to_string);
+    ADD_BUILTIN_PROC("string->number", string_to_number);
+    ADD_BUILTIN_PROC("symbol->string", symbol_to_string);
+    ADD_BUILTIN_PROC("string->symbol", string_to_symbol);
 
     ADD_BUILTIN_PROC("make-vector", make_vector);
     ADD_BUILTIN_PROC("vector-set!", vector_set);
     ADD_BUILTIN_PROC("vector-ref", vector_ref);
     ADD_BUILTIN_PROC("vector-length", vector_length);
+    ADD_BUILTIN_PROC("vector", vector);
+    ADD_BUILTIN_PROC("vector-fill!", vector_fill);
+    ADD_BUILTIN_PROC("vector-copy", vector_copy);
+    ADD_BUILTIN_PROC("subvector", vector_copy);
+    ADD_BUILTIN_PROC("vector-copy!", vector_copy_to);
+    ADD_BUILTIN_PROC("vector-grow", vector_grow);
+    ADD_BUILTIN_PROC("vector->list", vector_to_list);
+    ADD_BUILTIN_PROC("list->vector", list_to_vector);
+
+    ADD_BUILTIN_PROC("make-hash-table", make_hash_table);
+    ADD_BUILTIN_PROC("make-weak-hash-table", make_weak_hash_table);
+    ADD_BUILTIN_PROC("hash-table?", is_hash_table);
+    ADD_BUILTIN_PROC("hash-table-ref", hash_table_ref);
+    ADD_BUILTIN_PROC("hash-table-ref/default", hash_table_ref_default);
+    ADD_BUILTIN_PROC("hash-table-set!", hash_table_set);
+    ADD_BUILTIN_PROC("hash-table-delete!", hash_table_delete);
+    ADD_BUILTIN_PROC("hash-table-contains?", hash_table_contains);
+    ADD_BUILTIN_PROC("hash-table-count", hash_table_count);
+    ADD_BUILTIN_PROC("hash-table-keys", hash_table_keys);
+    ADD_BUILTIN_PROC("hash-table-values", hash_table_values);
+    ADD_BUILTIN_PROC("hash-table->alist", hash_table_to_alist);
+    ADD_BUILTIN_PROC("hash-table-clear!", hash_table_clear);
+    for (int i = 0; i < HOMO_KIND_NUM; i++)
+    {
+        // SRFI-4 homogeneous vectors, such as `f64vector-ref`
+        string tag = string(HOMO_TAG[i]) + "vector";
+        ADD_BUILTIN_PROC("make-" + tag, make_homovec);
+        ADD_BUILTIN_PROC("list->" + tag, list_to_homovec);
+        ADD_BUILTIN_PROC(tag, homovec);
+        ADD_BUILTIN_PROC(tag + "?", is_homovec);
+        ADD_BUILTIN_PROC(tag + "-length", homovec_length);
+        ADD_BUILTIN_PROC(tag + "-ref", homovec_ref);
+        ADD_BUILTIN_PROC(tag + "-set!", homovec_set);
+        ADD_BUILTIN_PROC(tag + "-fill!", homovec_fill);
+        ADD_BUILTIN_PROC(tag + "->list", homovec_to_list);
+        if (!homo_is_float(HomoKind(i))) continue;
+        ADD_BUILTIN_PROC(tag + "-add", homovec_add);
+        ADD_BUILTIN_PROC(tag + "-mul", homovec_mul);
+        ADD_BUILTIN_PROC(tag + "-dot", homovec_dot);
+        ADD_BUILTIN_PROC(tag + "-scale", homovec_scale);
+        ADD_BUILTIN_PROC(tag + "-sum", homovec_sum);
+        ADD_BUILTIN_PROC(tag + "-min", homovec_min);
+        ADD_BUILTIN_PROC(tag + "-max", homovec_max);
+    }
+    // bytevectors are the u8 vectors
+    ADD_BUILTIN_PROC("make-bytevector", make_homovec);
+    ADD_BUILTIN_PROC("bytevector", homovec);
+    ADD_BUILTIN_PROC("bytevector?", is_homovec);
+    ADD_BUILTIN_PROC("bytevector-length", homovec_length);
+    ADD_BUILTIN_PROC("bytevector-fill!", homovec_fill);
+    ADD_BUILTIN_PROC("bytevector-copy", bytevector_copy);
+    ADD_BUILTIN_PROC("bytevector-copy!", bytevector_copy_to);
+    ADD_BUILTIN_PROC("bytevector-append", bytevector_append);
+    ADD_BUILTIN_PROC("utf8->string", utf8_to_string);
+    ADD_BUILTIN_PROC("string->utf8", string_to_utf8);
+    ADD_BUILTIN_PROC("read-bytevector", read_bytevector);
+    ADD_BUILTIN_PROC("write-bytevector", write_bytevector);
+    for (int i = 0; i < HOMO_KIND_NUM; i++)
+    {
+        // binary accessors, such as `bytevector-u32-ref` and
+        // `bytevector-ieee-double-native-set!`
+        string acc = string("bytevector-") +
+            (i == HOMO_F32 ? "ieee-single" :
+             i == HOMO_F64 ? "ieee-double" : HOMO_TAG[i]);
+        ADD_BUILTIN_PROC(acc + "-ref", bytevector_ref);
+        ADD_BUILTIN_PROC(acc + "-set!", bytevector_set);
+        if (HOMO_ELEM_SIZE[i] == 1) continue;
+        ADD_BUILTIN_PROC(acc + "-native-ref", bytevector_ref);
+        ADD_BUILTIN_PROC(acc + "-native-set!", bytevector_set);
+    }
+    ADD_BUILTIN_PROC("equal-hash", equal_hash);
+    ADD_BUILTIN_PROC("hash", equal_hash);
+    ADD_BUILTIN_PROC("eqv-hash", eqv_hash);
+    ADD_BUILTIN_PROC("eq-hash", eqv_hash);
+    ADD_BUILTIN_PROC("string-hash", string_hash);
+    ADD_BUILTIN_PROC("string-ci-hash", string_ci_hash);
 
     ADD_BUILTIN_PROC("gc-status", gc_status);
     ADD_BUILTIN_PROC("set-gc-resolve-threshold!", set_gc_resolve_threshold);
@@ -218,3 +411,11 @@ EvalObj *Evaluator::run_expr(Pair *prog) {
     // static_cast because the previous while condition
     return static_cast<EvalObj*>(*(eval_stack));
 }
+
+void Evaluator::dump_image(OutputSink &out) {
+    serialize_image(envt, out);
+}
+
+void Evaluator::load_image(InPortObj *port) {
+    deserialize_image(envt, port);
+}
@@ -3,6 +3,8 @@
 #include "model.h"
 #include "types.h"
 
+class InPortObj;
+
 /** @class Evaluator
  * A realtime interpreting platform
  */
@@ -13,6 +15,10 @@ class Evaluator {
     public:
         Evaluator();
         EvalObj *run_expr(Pair *prog);  /**< Interpret a program */
+        /** Write the heap image of the top-level environment */
+        void dump_image(OutputSink &out);
+        /** Restore the top-level environment from a heap image */
+        void load_image(InPortObj *port);
 };
 
 #endif
@@ -2,14 +2,16 @@
 #include "exc.h"
 #include "consts.h"
 #include <vector>
+#include <algorithm>
 
 #include <cstdio>
 #if defined(GC_DEBUG) || defined (GC_INFO)
 typedef unsigned long long ull;
 #endif
 
-static EvalObj *gcq[GC_QUEUE_SIZE];
-static Container *cyc_list[GC_QUEUE_SIZE];
+/** The work queues, which grow with the number of objects */
+static std::vector<EvalObj*> gcq(GC_QUEUE_SIZE);
+static std::vector<Container*> cyc_list(GC_QUEUE_SIZE);
 GCRecord *oe_null;
 
 GarbageCollector::GarbageCollector() {
@@ -17,7 +19,7 @@ GarbageCollector::GarbageCollector() {
     joined->next = oe_null = new GCRecord(NULL, NULL);
     joined_size = 0;
     pending_list = NULL;
-    resolve_threshold = GC_CYC_THRESHOLD;
+    resolve_threshold = resolve_point = GC_CYC_THRESHOLD;
 }
 
 GarbageCollector::PendingEntry::PendingEntry(
@@ -25,7 +27,8 @@ GarbageCollector::PendingEntry::PendingEntry(
 
 
 void GarbageCollector::expose(EvalObj *ptr) {
-    if (ptr == NULL || ptr->gc_rec == NULL) return;
+    if (ptr == NULL || (!garbage.empty() && garbage.count(ptr)) ||
+            ptr->gc_rec == NULL) return;
 #ifdef GC_DEBUG
     fprintf(stderr, "GC: 0x%llx exposed. count = %lu \"%s\"\n", 
             (ull)ptr, ptr->gc_rec->gc_cnt - 1, ptr->ext_repr().c_str());
@@ -40,13 +43,16 @@ void GarbageCollector::expose(EvalObj *ptr) {
 }
 
 void GarbageCollector::force() {
-    EvalObj **l = gcq, **r = l;
+    size_t l = 0, r = 0;
     for (PendingEntry *p = pending_list, *np; p; p = np)
     {
         np = p->next;
         EvalObj *obj = p->obj;
         if (obj->gc_rec && !obj->gc_rec->gc_cnt)
-            *r++ = obj;
+        {
+            if (r == gcq.size()) gcq.resize(r << 1);
+            gcq[r++] = obj;
+        }
         delete p;
     }   // fetch the pending pointers in the list
     // clear the list
@@ -65,20 +71,19 @@ void GarbageCollector::force() {
     {
 #ifdef GC_DEBUG
         fprintf(stderr, "GC: !!! destroying space 0x%llx: %s. \n", 
-                (ull)*l, (*l)->ext_repr().c_str());
+                (ull)gcq[l], gcq[l]->ext_repr().c_str());
 #endif
 #ifdef GC_INFO
         cnt++;
 #endif
-        delete *l;
+        delete gcq[l];
         // maybe it's a complex structure, 
         // so that more pointers are reported
         for (PendingEntry *p = pending_list, *np; p; p = np)
         {
             np = p->next;
-            *r++ = p->obj;
-            if (r == gcq + GC_QUEUE_SIZE)
-                throw NormalError(RUN_ERR_GC_OVERFLOW);
+            if (r == gcq.size()) gcq.resize(r << 1);
+            gcq[r++] = p->obj;
             delete p;
         }   
         pending_list = NULL;
@@ -110,7 +115,13 @@ EvalObj *GarbageCollector::attach(EvalObj *ptr) {
 }
 
 void GarbageCollector::cycle_resolve() {
-    Container **clptr = cyc_list;
+    // no more than all joined objects are queued
+    if (cyc_list.size() < joined_size)
+    {
+        cyc_list.resize(joined_size);
+        gcq.resize(joined_size);
+    }
+    Container **clptr = &cyc_list[0];
     for (GCRecord *i = joined->next; i != oe_null; i = i->next)
     {
         EvalObj *obj = i->obj;
@@ -122,11 +133,11 @@ void GarbageCollector::cycle_resolve() {
         }
     }
 
-    EvalObj **l = gcq, **r = l;
-    for (Container **p = cyc_list; p < clptr; p++)
+    EvalObj **l = &gcq[0], **r = l;
+    for (Container **p = &cyc_list[0]; p < clptr; p++)
         (*p)->gc_decrement();
 
-    for (Container **p = cyc_list; p < clptr; p++)
+    for (Container **p = &cyc_list[0]; p < clptr; p++)
         if ((*p)->gc_refs)  // must not be recycled
             *r++ = *p;
 
@@ -136,11 +147,14 @@ void GarbageCollector::cycle_resolve() {
         p->keep = true;        
         p->gc_trigger(r);
     }
-    for (Container **p = cyc_list; p < clptr; p++)
+    for (Container **p = &cyc_list[0]; p < clptr; p++)
         if (!(*p)->keep) 
-        {
-            delete *p;
-        }
+            garbage.insert(*p);
+    // the garbage may refer to each other, so `expose` must ignore them
+    // while they are being destroyed
+    for (EvalObjSet::iterator it = garbage.begin(); it != garbage.end(); it++)
+        delete *it;
+    garbage.clear();
 #ifdef GC_INFO
     fprintf(stderr, "GC: cycle resolved.\n");
 #endif
@@ -148,10 +162,15 @@ void GarbageCollector::cycle_resolve() {
 
 void GarbageCollector::collect() {
     force();
-    if (joined_size >= resolve_threshold) 
+    if (joined_size >= resolve_point) 
     {
         cycle_resolve();
         force();
+        // let the live objects double before the next pass, otherwise a
+        // large live set makes every collection a full scan (a zero
+        // threshold still resolves on every collection)
+        resolve_point = resolve_threshold ?
+            std::max(resolve_threshold, joined_size * 2) : 0;
     }
 }
 
@@ -160,7 +179,7 @@ size_t GarbageCollector::get_remaining() {
 }
 
 void GarbageCollector::set_resolve_threshold(size_t new_thres) {
-    resolve_threshold = new_thres;
+    resolve_threshold = resolve_point = new_thres;
 }
 
 GCRecord *GarbageCollector::join(EvalObj *ptr) {
@@ -174,6 +193,14 @@ GCRecord *GarbageCollector::join(EvalObj *ptr) {
 }
 
 void GarbageCollector::quit(EvalObj *ptr) {
+    if (!weak_refs.empty())
+    {
+        std::pair<WeakRefMap::iterator, WeakRefMap::iterator> range =
+            weak_refs.equal_range(ptr);
+        for (WeakRefMap::iterator it = range.first; it != range.second; it++)
+            it->second->drop_weak(ptr);
+        weak_refs.erase(range.first, range.second);
+    }
     GCRecord *p = ptr->gc_rec;
     p->prev->next = p->next;
     p->next->prev = p->prev;
@@ -182,5 +209,20 @@ void GarbageCollector::quit(EvalObj *ptr) {
     joined_size--;
 }
 
+void GarbageCollector::add_weak(EvalObj *obj, WeakHolder *holder) {
+    weak_refs.insert(WeakRefMap::value_type(obj, holder));
+}
+
+void GarbageCollector::remove_weak(EvalObj *obj, WeakHolder *holder) {
+    std::pair<WeakRefMap::iterator, WeakRefMap::iterator> range =
+        weak_refs.equal_range(obj);
+    for (WeakRefMap::iterator it = range.first; it != range.second; it++)
+        if (it->second == holder)
+        {
+            weak_refs.erase(it);
+            break;
+        }
+}
+
 GCRecord::GCRecord(GCRecord *_prev, GCRecord *_next) :
 prev(_prev), next(_next) {} 
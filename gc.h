@@ -3,6 +3,7 @@
 
 #include "model.h"
 #include <map>
+#include <unordered_map>
 
 const int GC_QUEUE_SIZE = 262144;
 const size_t GC_CYC_THRESHOLD = GC_QUEUE_SIZE >> 1;
@@ -61,6 +62,18 @@ struct GCRecord {
     GCRecord(GCRecord *prev, GCRecord *next);
 };
 
+/** @class WeakHolder
+ * An object which refers to others without keeping them alive, and is told
+ * when any of them is destroyed
+ */
+class WeakHolder {/*{{{*/
+    public:
+        /** Called when `obj`, weakly referred, is being destroyed */
+        virtual void drop_weak(EvalObj *obj) = 0;
+};/*}}}*/
+
+typedef std::unordered_multimap<EvalObj*, WeakHolder*> WeakRefMap;
+
 /** @class GarbageCollector
  * Which takes the responsibility of taking care of all existing EvalObj
  * in use as well as recycling those aren't
@@ -76,7 +89,13 @@ class GarbageCollector {
     GCRecord *joined;
     PendingEntry *pending_list;
     size_t resolve_threshold;
+    /** `cycle_resolve` runs when this many objects have joined */
+    size_t resolve_point;
     size_t joined_size;
+    /** The containers being recycled by `cycle_resolve` */
+    EvalObjSet garbage;
+    /** The holders of weak references, by the referred objects */
+    WeakRefMap weak_refs;
 
     void cycle_resolve();
     void force();
@@ -94,6 +113,11 @@ class GarbageCollector {
     /** Call this when an EvalObj is destroyed */
     void quit(EvalObj *ptr);
 
+    /** Let `holder` know when `obj` is destroyed */
+    void add_weak(EvalObj *obj, WeakHolder *holder);
+    /** Stop telling `holder` about `obj` */
+    void remove_weak(EvalObj *obj, WeakHolder *holder);
+
     /** Get the number of EvalObj in use */
     size_t get_remaining();
     /** Set the threshold for cycle_resolve */
@@ -0,0 +1,368 @@
+#include "hash.h"
+#include "builtin.h"
+#include "exc.h"
+#include "homovec.h"
+
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+extern EmptyList *empty_list;
+
+/** The number of components `equal_hash` looks into from the head */
+static const int EQUAL_HASH_LIMIT = 64;
+/** The number of trailing elements of a list or a vector `equal_hash`
+ * also looks into, each with this many components */
+static const int EQUAL_HASH_TAIL = 8;
+/** The initial size of the entry array */
+static const size_t HASH_INIT_SIZE = 8;
+
+static inline size_t hash_mix(size_t h, size_t val) {
+    h ^= val + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+static inline size_t hash_ptr(EvalObj *obj) {
+    size_t h = (size_t)obj;
+    return (h >> 4) * 0x9e3779b97f4a7c15ULL;
+}
+
+static size_t hash_double(double val) {
+    if (val == 0) val = 0;  // -0.0 is eqv to 0.0
+    unsigned long long bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return std::hash<unsigned long long>()(bits);
+}
+
+#ifdef GMP_SUPPORT
+static size_t hash_mpz(const mpz_class &val) {
+    return hash_mix(mpz_get_ui(val.get_mpz_t()), sgn(val) + 1);
+}
+#endif
+
+static size_t hash_number(NumObj *num) {
+    switch (num->level)
+    {
+        case NUM_LVL_INT:
+#ifdef GMP_SUPPORT
+            return hash_mpz(static_cast<IntNumObj*>(num)->val);
+#else
+            return std::hash<int>()(static_cast<IntNumObj*>(num)->val);
+#endif
+        case NUM_LVL_RAT:
+            {
+                // an integral rational must agree with the integer
+                RatNumObj *rat = static_cast<RatNumObj*>(num);
+#ifdef GMP_SUPPORT
+                size_t h = hash_mpz(rat->val.get_num());
+                return rat->val.get_den() == 1 ? h :
+                    hash_mix(h, hash_mpz(rat->val.get_den()));
+#else
+                if (rat->a % rat->b == 0)
+                    return std::hash<int>()(rat->a / rat->b);
+                return hash_mix(std::hash<int>()(rat->a),
+                                std::hash<int>()(rat->b));
+#endif
+            }
+        case NUM_LVL_REAL:
+            return hash_double(static_cast<RealNumObj*>(num)->real);
+        default:
+            {
+                // a complex number with no imaginary part is a real one
+                CompNumObj *comp = static_cast<CompNumObj*>(num);
+                size_t h = hash_double(comp->real);
+                return comp->imag == 0 ? h :
+                    hash_mix(h, hash_double(comp->imag));
+            }
+    }
+}
+
+size_t string_hash(const string &str) {
+    return std::hash<string>()(str);
+}
+
+size_t string_hash(const char *str, size_t len) {
+    return std::hash<std::string_view>()(std::string_view(str, len));
+}
+
+size_t eqv_hash(EvalObj *obj) {
+    int otype = obj->get_otype();
+    if (otype & CLS_BOOL_OBJ)
+        return static_cast<BoolObj*>(obj)->val;
+    if (otype & CLS_SYM_OBJ)
+        return string_hash(static_cast<SymObj*>(obj)->val);
+    if (otype & CLS_NUM_OBJ)
+    {
+        NumObj *num = static_cast<NumObj*>(obj);
+        return hash_mix(hash_number(num), num->is_exact());
+    }
+    if (otype & CLS_CHAR_OBJ)
+        return (unsigned char)static_cast<CharObj*>(obj)->ch;
+    return hash_ptr(obj);
+}
+
+/** Hash the first `limit` components of `obj`, which is at most
+ * EQUAL_HASH_LIMIT */
+static size_t hash_components(EvalObj *obj, int limit) {
+    EvalObj *stack[EQUAL_HASH_LIMIT];
+    int top = 0, cnt = 0;
+    size_t h = 0;
+    stack[top++] = obj;
+    // the components are visited in the same order for equal objects, and
+    // those beyond the limit are ignored
+    while (top && cnt++ < limit)
+    {
+        obj = stack[--top];
+        if (obj->is_pair_obj() && obj != empty_list)
+        {
+            h = hash_mix(h, 1);
+            if (top + 2 <= limit)
+            {
+                stack[top++] = TO_PAIR(obj)->cdr;
+                stack[top++] = TO_PAIR(obj)->car;
+            }
+        }
+        else if (obj->is_vect_obj())
+        {
+            EvalObjVec &vec = static_cast<VecObj*>(obj)->vec;
+            h = hash_mix(h, vec.size() + 2);
+            for (size_t i = vec.size(); i > 0 && top < limit; i--)
+                stack[top++] = vec[i - 1];
+        }
+        else if (obj->is_str_obj())
+        {
+            StrObj *str = static_cast<StrObj*>(obj);
+            h = hash_mix(h, string_hash(str->data(), str->length()));
+        }
+        else if (obj->get_otype() & CLS_HOMO_OBJ)
+            h = hash_mix(h, string_hash(static_cast<HomoVecObj*>(obj)->data) +
+                            static_cast<HomoVecObj*>(obj)->get_kind());
+        else if (obj == empty_list)
+            h = hash_mix(h, 3);
+        else
+            h = hash_mix(h, eqv_hash(obj));
+    }
+    return h;
+}
+
+/** Count the pairs of the list `obj` in `len`, and find the pair that
+ * starts its last EQUAL_HASH_TAIL elements
+ * @return NULL if the list is circular */
+static EvalObj *list_tail(EvalObj *obj, size_t &len) {
+    EvalObj *p = obj, *slow = obj, *tail = obj;
+    for (len = 0; p->is_pair_obj() && p != empty_list; )
+    {
+        p = TO_PAIR(p)->cdr;
+        if (++len > (size_t)EQUAL_HASH_TAIL)
+            tail = TO_PAIR(tail)->cdr;
+        if (!(len & 1) && (slow = TO_PAIR(slow)->cdr) == p)
+            return NULL;
+    }
+    return tail;
+}
+
+size_t equal_hash(EvalObj *obj) {
+    size_t h = hash_components(obj, EQUAL_HASH_LIMIT);
+    // keys that share a long head still differ in their length or their
+    // last elements
+    if (obj->is_pair_obj() && obj != empty_list)
+    {
+        size_t len;
+        // a circular list may equal one of another length
+        EvalObj *tail = list_tail(obj, len);
+        if (tail && len > (size_t)EQUAL_HASH_TAIL)
+        {
+            h = hash_mix(h, len);
+            for (; tail->is_pair_obj() && tail != empty_list;
+                    tail = TO_PAIR(tail)->cdr)
+                h = hash_mix(h, hash_components(TO_PAIR(tail)->car,
+                                                EQUAL_HASH_TAIL));
+            h = hash_mix(h, hash_components(tail, 1));
+        }
+    }
+    else if (obj->is_vect_obj())
+    {
+        EvalObjVec &vec = static_cast<VecObj*>(obj)->vec;
+        for (size_t i = vec.size() > (size_t)EQUAL_HASH_TAIL ?
+                vec.size() - EQUAL_HASH_TAIL : vec.size();
+                i < vec.size(); i++)
+            h = hash_mix(h, hash_components(vec[i], EQUAL_HASH_TAIL));
+    }
+    return h;
+}
+
+HashTableObj::HashTableObj(HashKind _kind) :
+Container(CLS_SIM_OBJ | CLS_HASH_OBJ), kind(_kind), count(0), used(0) {}
+
+HashTableObj::~HashTableObj() {
+    clear();
+}
+
+size_t HashTableObj::hash(EvalObj *key) {
+    size_t h;
+    switch (kind)
+    {
+        case HASH_EQV: h = eqv_hash(key); break;
+        case HASH_EQUAL: h = equal_hash(key); break;
+        case HASH_STRING:
+            if (!key->is_str_obj())
+                throw TokenError("a string", RUN_ERR_WRONG_TYPE);
+            h = string_hash(static_cast<StrObj*>(key)->data(),
+                            static_cast<StrObj*>(key)->length());
+            break;
+        default: h = hash_ptr(key);
+    }
+    return h > HASH_DELETED ? h : h + 2;
+}
+
+bool HashTableObj::same(EvalObj *a, EvalObj *b) {
+    if (a == b) return true;
+    switch (kind)
+    {
+        case HASH_EQV: return is_eqv_obj(a, b);
+        case HASH_EQUAL: return is_equal_obj(a, b);
+        case HASH_STRING:
+            return static_cast<StrObj*>(a)->eq(static_cast<StrObj*>(b));
+        default: return false;
+    }
+}
+
+size_t HashTableObj::find(EvalObj *key, size_t h) {
+    size_t size = entries.size();
+    if (!count) return size;
+    size_t mask = size - 1;
+    for (size_t i = h & mask; ; i = (i + 1) & mask)
+    {
+        HashEntry &e = entries[i];
+        if (e.hash == HASH_FREE) return size;
+        if (e.hash == h && same(e.key, key)) return i;
+    }
+}
+
+void HashTableObj::resize(size_t size) {
+    std::vector<HashEntry> old(size, (HashEntry){HASH_FREE, NULL, NULL});
+    old.swap(entries);
+    size_t mask = size - 1;
+    for (size_t j = 0; j < old.size(); j++)
+        if (old[j].hash > HASH_DELETED)
+        {
+            size_t i = old[j].hash & mask;
+            while (entries[i].hash != HASH_FREE)
+                i = (i + 1) & mask;
+            entries[i] = old[j];
+        }
+    used = count;
+}
+
+void HashTableObj::erase(size_t idx) {
+    HashEntry &e = entries[idx];
+    if (kind == HASH_WEAK)
+        gc.remove_weak(e.key, this);
+    else
+        gc.expose(e.key);
+    gc.expose(e.val);
+    e.hash = HASH_DELETED;
+    e.key = e.val = NULL;
+    count--;
+}
+
+HashKind HashTableObj::get_kind() { return kind; }
+
+size_t HashTableObj::get_count() { return count; }
+
+EvalObj *HashTableObj::get(EvalObj *key) {
+    size_t idx = find(key, hash(key));
+    return idx < entries.size() ? entries[idx].val : NULL;
+}
+
+void HashTableObj::set(EvalObj *key, EvalObj *val) {
+    size_t h = hash(key);
+    size_t idx = find(key, h);
+    if (idx < entries.size())
+    {
+        gc.expose(entries[idx].val);
+        entries[idx].val = gc.attach(val);
+        return;
+    }
+    // keep at least a quarter of the entries free, so probing stays short
+    if ((used + 1) * 4 > entries.size() * 3)
+    {
+        size_t size = entries.size() ? entries.size() : HASH_INIT_SIZE;
+        while ((count + 1) * 2 > size) size <<= 1;
+        resize(size);
+    }
+    size_t mask = entries.size() - 1;
+    idx = h & mask;
+    while (entries[idx].hash > HASH_DELETED)
+        idx = (idx + 1) & mask;
+    if (entries[idx].hash == HASH_FREE) used++;
+    HashEntry &e = entries[idx];
+    e.hash = h;
+    if (kind == HASH_WEAK)
+        gc.add_weak(e.key = key, this);
+    else
+        e.key = gc.attach(key);
+    e.val = gc.attach(val);
+    count++;
+}
+
+bool HashTableObj::remove(EvalObj *key) {
+    size_t idx = find(key, hash(key));
+    if (idx == entries.size()) return false;
+    erase(idx);
+    return true;
+}
+
+void HashTableObj::clear() {
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries[i].hash > HASH_DELETED)
+            erase(i);
+    entries.clear();
+    used = 0;
+}
+
+void HashTableObj::get_entries(EvalObjVec &keys, EvalObjVec &vals) {
+    keys.reserve(count);
+    vals.reserve(count);
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries[i].hash > HASH_DELETED)
+        {
+            keys.push_back(entries[i].key);
+            vals.push_back(entries[i].val);
+        }
+}
+
+void HashTableObj::drop_weak(EvalObj *obj) {
+    size_t idx = find(obj, hash(obj));
+    if (idx == entries.size()) return;
+    // the collector forgets about the reference by itself
+    HashEntry &e = entries[idx];
+    gc.expose(e.val);
+    e.hash = HASH_DELETED;
+    e.key = e.val = NULL;
+    count--;
+}
+
+ReprCons *HashTableObj::get_repr_cons() {
+    return new ReprStr("#<Hash Table>");
+}
+
+void HashTableObj::gc_decrement() {
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries[i].hash > HASH_DELETED)
+        {
+            if (kind != HASH_WEAK)
+                GC_CYC_DEC(entries[i].key);
+            GC_CYC_DEC(entries[i].val);
+        }
+}
+
+void HashTableObj::gc_trigger(EvalObj ** &tail) {
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries[i].hash > HASH_DELETED)
+        {
+            if (kind != HASH_WEAK)
+                GC_CYC_TRIGGER(entries[i].key);
+            GC_CYC_TRIGGER(entries[i].val);
+        }
+}
@@ -0,0 +1,85 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include "types.h"
+#include "gc.h"
+#include <vector>
+
+const int CLS_HASH_OBJ = 1 << 16;
+
+/** How the keys of a hash table are compared */
+enum HashKind {
+    HASH_EQV,       /**< By `eqv?` (which is also `eq?`) */
+    HASH_EQUAL,     /**< By `equal?` */
+    HASH_STRING,    /**< By `string=?` */
+    HASH_WEAK       /**< By identity, without keeping the keys alive */
+};
+
+/** Hash the content of a string, consistently with `string=?` */
+size_t string_hash(const string &str);
+/** Hash the `len` characters at `str` as `string_hash` does */
+size_t string_hash(const char *str, size_t len);
+/** Hash `obj` consistently with `eqv?` */
+size_t eqv_hash(EvalObj *obj);
+/** Hash `obj` consistently with `equal?`, looking into a bounded number of
+ * components, so it is cheap and safe on circular structures */
+size_t equal_hash(EvalObj *obj);
+
+/** An entry of a hash table, whose hash is HASH_FREE or HASH_DELETED if the
+ * entry is not in use */
+struct HashEntry {
+    size_t hash;
+    EvalObj *key;
+    EvalObj *val;
+};
+
+const size_t HASH_FREE = 0;
+const size_t HASH_DELETED = 1;
+
+/** @class HashTableObj
+ * A hash table with open addressing: the entries are kept in a single
+ * power-of-two sized array and probed linearly
+ */
+class HashTableObj : public Container, public WeakHolder {/*{{{*/
+    private:
+        HashKind kind;
+        std::vector<HashEntry> entries;
+        size_t count;           /**< The number of keys */
+        size_t used;            /**< The number of entries not free */
+        /** Hash a key, the result is never HASH_FREE or HASH_DELETED */
+        size_t hash(EvalObj *key);
+        /** Test if two keys are the same */
+        bool same(EvalObj *a, EvalObj *b);
+        /** Find the entry of `key` whose hash is `h`
+         * @return the index, or the size of the array if not found */
+        size_t find(EvalObj *key, size_t h);
+        /** Move all entries into an array of `size` entries */
+        void resize(size_t size);
+        /** Drop the entry at `idx` */
+        void erase(size_t idx);
+    public:
+        /** Construct an empty table */
+        HashTableObj(HashKind kind);
+        ~HashTableObj();
+        HashKind get_kind();
+        /** Get the number of keys */
+        size_t get_count();
+        /** Get the value of `key`, or NULL if absent */
+        EvalObj *get(EvalObj *key);
+        /** Bind `key` to `val` */
+        void set(EvalObj *key, EvalObj *val);
+        /** Remove `key`
+         * @return true if it was present */
+        bool remove(EvalObj *key);
+        /** Remove all keys */
+        void clear();
+        /** Get all entries in use */
+        void get_entries(EvalObjVec &keys, EvalObjVec &vals);
+        void drop_weak(EvalObj *obj);
+        ReprCons *get_repr_cons();
+
+        void gc_decrement();
+        void gc_trigger(EvalObj ** &tail);
+};/*}}}*/
+
+#endif
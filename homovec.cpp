@@ -0,0 +1,531 @@
+#include "homovec.h"
+#include "exc.h"
+#include "consts.h"
+
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+const char *HOMO_TAG[HOMO_KIND_NUM] = {
+    "u8", "s8", "u16", "s16", "u32", "s32", "u64", "s64", "f32", "f64"
+};
+
+const size_t HOMO_ELEM_SIZE[HOMO_KIND_NUM] = {1, 1, 2, 2, 4, 4, 8, 8, 4, 8};
+
+/** The range of the integer kinds */
+static const long long HOMO_MIN[] = {
+    0, INT8_MIN, 0, INT16_MIN, 0, INT32_MIN, 0, INT64_MIN
+};
+static const unsigned long long HOMO_MAX[] = {
+    UINT8_MAX, INT8_MAX, UINT16_MAX, INT16_MAX,
+    UINT32_MAX, INT32_MAX, UINT64_MAX, INT64_MAX
+};
+
+int homo_kind_of_tag(const char *tag, size_t len) {
+    for (int i = 0; i < HOMO_KIND_NUM; i++)
+        if (strlen(HOMO_TAG[i]) == len && !memcmp(HOMO_TAG[i], tag, len))
+            return i;
+    return -1;
+}
+
+bool homo_is_float(HomoKind kind) {
+    return kind == HOMO_F32 || kind == HOMO_F64;
+}
+
+void homo_encode(HomoKind kind, EvalObj *obj, char *dst) {
+    if (!obj->is_num_obj())
+        throw TokenError("a number", RUN_ERR_WRONG_TYPE);
+    NumObj *num = static_cast<NumObj*>(obj);
+    if (kind == HOMO_F64)
+    {
+        double val = num_to_double(num);
+        memcpy(dst, &val, sizeof(val));
+        return;
+    }
+    if (kind == HOMO_F32)
+    {
+        float val = num_to_double(num);
+        memcpy(dst, &val, sizeof(val));
+        return;
+    }
+    if (num->level != NUM_LVL_INT)
+        throw TokenError("an integer", RUN_ERR_WRONG_TYPE);
+    unsigned long long bits;
+#ifdef GMP_SUPPORT
+    const mpz_class &val = static_cast<IntNumObj*>(num)->val;
+    if (sgn(val) < 0)
+    {
+        if (!val.fits_slong_p() || val.get_si() < HOMO_MIN[kind])
+            throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+        bits = val.get_si();
+    }
+    else
+    {
+        if (!val.fits_ulong_p() || val.get_ui() > HOMO_MAX[kind])
+            throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+        bits = val.get_ui();
+    }
+#else
+    long long val = static_cast<IntNumObj*>(num)->val;
+    if (val < HOMO_MIN[kind] ||
+            (val > 0 && (unsigned long long)val > HOMO_MAX[kind]))
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    bits = val;
+#endif
+    switch (HOMO_ELEM_SIZE[kind])
+    {
+        case 1: { uint8_t v = bits; memcpy(dst, &v, 1); break; }
+        case 2: { uint16_t v = bits; memcpy(dst, &v, 2); break; }
+        case 4: { uint32_t v = bits; memcpy(dst, &v, 4); break; }
+        default: memcpy(dst, &bits, 8);
+    }
+}
+
+template<typename T> static T load(const char *src) {
+    T val;
+    memcpy(&val, src, sizeof(val));
+    return val;
+}
+
+#ifdef GMP_SUPPORT
+#define NEW_INT(val) new IntNumObj(mpz_class(val))
+#else
+#define NEW_INT(val) new IntNumObj(int(val))
+#endif
+
+EvalObj *homo_decode(HomoKind kind, const char *src) {
+    switch (kind)
+    {
+        case HOMO_U8: return NEW_INT(load<uint8_t>(src));
+        case HOMO_S8: return NEW_INT(load<int8_t>(src));
+        case HOMO_U16: return NEW_INT(load<uint16_t>(src));
+        case HOMO_S16: return NEW_INT(load<int16_t>(src));
+        case HOMO_U32: return NEW_INT(load<uint32_t>(src));
+        case HOMO_S32: return NEW_INT(load<int32_t>(src));
+        case HOMO_U64: return NEW_INT(load<uint64_t>(src));
+        case HOMO_S64: return NEW_INT(load<int64_t>(src));
+        case HOMO_F32: return new RealNumObj(load<float>(src));
+        default: return new RealNumObj(load<double>(src));
+    }
+}
+
+#undef NEW_INT
+
+/** Get the external representation of the element of `kind` at `src` */
+static string elem_to_str(HomoKind kind, const char *src) {
+    switch (kind)
+    {
+        case HOMO_U8: return std::to_string(load<uint8_t>(src));
+        case HOMO_S8: return std::to_string(load<int8_t>(src));
+        case HOMO_U16: return std::to_string(load<uint16_t>(src));
+        case HOMO_S16: return std::to_string(load<int16_t>(src));
+        case HOMO_U32: return std::to_string(load<uint32_t>(src));
+        case HOMO_S32: return std::to_string(load<int32_t>(src));
+        case HOMO_U64: return std::to_string(load<uint64_t>(src));
+        case HOMO_S64: return std::to_string(load<int64_t>(src));
+        case HOMO_F32: return double_to_str(load<float>(src));
+        default: return double_to_str(load<double>(src));
+    }
+}
+
+HomoVecObj::HomoVecObj(HomoKind _kind, size_t size) :
+EvalObj(CLS_SIM_OBJ | CLS_HOMO_OBJ), kind(_kind),
+data(size * HOMO_ELEM_SIZE[_kind], '\0') {}
+
+HomoVecObj::HomoVecObj(HomoKind _kind, string _data) :
+EvalObj(CLS_SIM_OBJ | CLS_HOMO_OBJ), kind(_kind), data(std::move(_data)) {}
+
+HomoKind HomoVecObj::get_kind() { return kind; }
+
+size_t HomoVecObj::get_size() { return data.length() / HOMO_ELEM_SIZE[kind]; }
+
+EvalObj *HomoVecObj::get(size_t idx) {
+    if (idx >= get_size())
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    return homo_decode(kind, &data[idx * HOMO_ELEM_SIZE[kind]]);
+}
+
+void HomoVecObj::set(size_t idx, EvalObj *obj) {
+    if (idx >= get_size())
+        throw NormalError(RUN_ERR_VALUE_OUT_OF_RANGE);
+    homo_encode(kind, obj, &data[idx * HOMO_ELEM_SIZE[kind]]);
+}
+
+void HomoVecObj::fill(EvalObj *obj) {
+    size_t esize = HOMO_ELEM_SIZE[kind];
+    char elem[8];
+    homo_encode(kind, obj, elem);
+    if (esize == 1)
+        memset(&data[0], elem[0], data.length());
+    else
+        for (size_t i = 0; i < data.length(); i += esize)
+            memcpy(&data[i], elem, esize);
+}
+
+ReprCons *HomoVecObj::get_repr_cons() {
+    string repr = string("#") + HOMO_TAG[kind] + "(";
+    size_t esize = HOMO_ELEM_SIZE[kind];
+    for (size_t i = 0; i < data.length(); i += esize)
+    {
+        if (i) repr += ' ';
+        repr += elem_to_str(kind, &data[i]);
+    }
+    return new ReprStr(repr + ")");
+}
+
+/* Portable kernels, used for f32 and where no SIMD kernel exists */
+
+template<typename T>
+static void scalar_add(T *res, const T *a, const T *b, size_t n) {
+    for (size_t i = 0; i < n; i++) res[i] = a[i] + b[i];
+}
+
+template<typename T>
+static void scalar_mul(T *res, const T *a, const T *b, size_t n) {
+    for (size_t i = 0; i < n; i++) res[i] = a[i] * b[i];
+}
+
+template<typename T>
+static void scalar_scale(T *res, const T *a, double k, size_t n) {
+    for (size_t i = 0; i < n; i++) res[i] = a[i] * k;
+}
+
+template<typename T>
+static double scalar_dot(const T *a, const T *b, size_t n) {
+    double res = 0;
+    for (size_t i = 0; i < n; i++) res += double(a[i]) * b[i];
+    return res;
+}
+
+template<typename T>
+static double scalar_sum(const T *a, size_t n) {
+    double res = 0;
+    for (size_t i = 0; i < n; i++) res += a[i];
+    return res;
+}
+
+/* The minimum and the maximum are NaN if any element is NaN, wherever it
+ * is, as with the other arithmetic on NaN */
+
+template<typename T>
+static double scalar_min(const T *a, size_t n) {
+    T res = a[0];
+    for (size_t i = 0; i < n; i++)
+    {
+        if (a[i] != a[i]) return NAN;
+        res = a[i] < res ? a[i] : res;
+    }
+    return res;
+}
+
+template<typename T>
+static double scalar_max(const T *a, size_t n) {
+    T res = a[0];
+    for (size_t i = 0; i < n; i++)
+    {
+        if (a[i] != a[i]) return NAN;
+        res = a[i] > res ? a[i] : res;
+    }
+    return res;
+}
+
+/** The f64 kernels for a particular instruction set */
+struct F64Kernels {
+    void (*add)(double *res, const double *a, const double *b, size_t n);
+    void (*mul)(double *res, const double *a, const double *b, size_t n);
+    void (*scale)(double *res, const double *a, double k, size_t n);
+    double (*dot)(const double *a, const double *b, size_t n);
+    double (*sum)(const double *a, size_t n);
+    double (*min)(const double *a, size_t n);
+    double (*max)(const double *a, size_t n);
+};
+
+#ifdef __x86_64__
+/* SSE2 is part of x86-64, AVX2 is only used if the CPU supports it */
+
+static void sse2_add(double *res, const double *a, const double *b, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(res + i,
+                _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    for (; i < n; i++) res[i] = a[i] + b[i];
+}
+
+static void sse2_mul(double *res, const double *a, const double *b, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(res + i,
+                _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    for (; i < n; i++) res[i] = a[i] * b[i];
+}
+
+static void sse2_scale(double *res, const double *a, double k, size_t n) {
+    __m128d vk = _mm_set1_pd(k);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(res + i, _mm_mul_pd(_mm_loadu_pd(a + i), vk));
+    for (; i < n; i++) res[i] = a[i] * k;
+}
+
+static double sse2_dot(const double *a, const double *b, size_t n) {
+    __m128d acc = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        acc = _mm_add_pd(acc,
+                _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    double part[2];
+    _mm_storeu_pd(part, acc);
+    double res = part[0] + part[1];
+    for (; i < n; i++) res += a[i] * b[i];
+    return res;
+}
+
+static double sse2_sum(const double *a, size_t n) {
+    __m128d acc = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        acc = _mm_add_pd(acc, _mm_loadu_pd(a + i));
+    double part[2];
+    _mm_storeu_pd(part, acc);
+    double res = part[0] + part[1];
+    for (; i < n; i++) res += a[i];
+    return res;
+}
+
+static double sse2_min(const double *a, size_t n) {
+    __m128d acc = _mm_set1_pd(a[0]), nan = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d val = _mm_loadu_pd(a + i);
+        acc = _mm_min_pd(val, acc);
+        nan = _mm_or_pd(_mm_cmpunord_pd(val, val), nan);
+    }
+    if (_mm_movemask_pd(nan)) return NAN;
+    double part[2];
+    _mm_storeu_pd(part, acc);
+    double res = part[0] < part[1] ? part[0] : part[1];
+    for (; i < n; i++)
+    {
+        if (a[i] != a[i]) return NAN;
+        res = a[i] < res ? a[i] : res;
+    }
+    return res;
+}
+
+static double sse2_max(const double *a, size_t n) {
+    __m128d acc = _mm_set1_pd(a[0]), nan = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d val = _mm_loadu_pd(a + i);
+        acc = _mm_max_pd(val, acc);
+        nan = _mm_or_pd(_mm_cmpunord_pd(val, val), nan);
+    }
+    if (_mm_movemask_pd(nan)) return NAN;
+    double part[2];
+    _mm_storeu_pd(part, acc);
+    double res = part[0] > part[1] ? part[0] : part[1];
+    for (; i < n; i++)
+    {
+        if (a[i] != a[i]) return NAN;
+        res = a[i] > res ? a[i] : res;
+    }
+    return res;
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+/** Add up the four lanes of `acc` */
+AVX2 static double avx2_hsum(__m256d acc) {
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc),
+                            _mm256_extractf128_pd(acc, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+AVX2 static void avx2_add(double *res, const double *a, const double *b,
+                            size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(res + i,
+                _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    for (; i < n; i++) res[i] = a[i] + b[i];
+}
+
+AVX2 static void avx2_mul(double *res, const double *a, const double *b,
+                            size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(res + i,
+                _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    for (; i < n; i++) res[i] = a[i] * b[i];
+}
+
+AVX2 static void avx2_scale(double *res, const double *a, double k,
+                            size_t n) {
+    __m256d vk = _mm256_set1_pd(k);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(res + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), vk));
+    for (; i < n; i++) res[i] = a[i] * k;
+}
+
+AVX2 static double avx2_dot(const double *a, const double *b, size_t n) {
+    // two accumulators hide the latency of the additions
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+                                                _mm256_loadu_pd(b + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4),
+                                                _mm256_loadu_pd(b + i + 4)));
+    }
+    double res = avx2_hsum(_mm256_add_pd(acc0, acc1));
+    for (; i < n; i++) res += a[i] * b[i];
+    return res;
+}
+
+AVX2 static double avx2_sum(const double *a, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(a + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(a + i + 4));
+    }
+    double res = avx2_hsum(_mm256_add_pd(acc0, acc1));
+    for (; i < n; i++) res += a[i];
+    return res;
+}
+
+AVX2 static double avx2_min(const double *a, size_t n) {
+    __m256d acc = _mm256_set1_pd(a[0]), nan = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d val = _mm256_loadu_pd(a + i);
+        acc = _mm256_min_pd(val, acc);
+        nan = _mm256_or_pd(_mm256_cmp_pd(val, val, _CMP_UNORD_Q), nan);
+    }
+    if (_mm256_movemask_pd(nan)) return NAN;
+    double part[4];
+    _mm256_storeu_pd(part, acc);
+    double res = part[0];
+    for (int j = 1; j < 4; j++) res = part[j] < res ? part[j] : res;
+    for (; i < n; i++)
+    {
+        if (a[i] != a[i]) return NAN;
+        res = a[i] < res ? a[i] : res;
+    }
+    return res;
+}
+
+AVX2 static double avx2_max(const double *a, size_t n) {
+    __m256d acc = _mm256_set1_pd(a[0]), nan = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d val = _mm256_loadu_pd(a + i);
+        acc = _mm256_max_pd(val, acc);
+        nan = _mm256_or_pd(_mm256_cmp_pd(val, val, _CMP_UNORD_Q), nan);
+    }
+    if (_mm256_movemask_pd(nan)) return NAN;
+    double part[4];
+    _mm256_storeu_pd(part, acc);
+    double res = part[0];
+    for (int j = 1; j < 4; j++) res = part[j] > res ? part[j] : res;
+    for (; i < n; i++)
+    {
+        if (a[i] != a[i]) return NAN;
+        res = a[i] > res ? a[i] : res;
+    }
+    return res;
+}
+
+#undef AVX2
+
+static const F64Kernels sse2_kernels = {
+    sse2_add, sse2_mul, sse2_scale, sse2_dot, sse2_sum, sse2_min, sse2_max
+};
+static const F64Kernels avx2_kernels = {
+    avx2_add, avx2_mul, avx2_scale, avx2_dot, avx2_sum, avx2_min, avx2_max
+};
+
+/** Pick the kernels once, by the instruction sets of the running CPU */
+static const F64Kernels &f64_kernels() {
+    static const F64Kernels &kernels =
+        __builtin_cpu_supports("avx2") ? avx2_kernels : sse2_kernels;
+    return kernels;
+}
+#else
+static const F64Kernels scalar_kernels = {
+    scalar_add<double>, scalar_mul<double>, scalar_scale<double>,
+    scalar_dot<double>, scalar_sum<double>,
+    scalar_min<double>, scalar_max<double>
+};
+
+static const F64Kernels &f64_kernels() { return scalar_kernels; }
+#endif
+
+HomoVecObj *homo_add(HomoVecObj *a, HomoVecObj *b) {
+    HomoVecObj *res = new HomoVecObj(a->get_kind(), a->get_size());
+    if (a->get_kind() == HOMO_F64)
+        f64_kernels().add(res->elems<double>(), a->elems<double>(),
+                            b->elems<double>(), a->get_size());
+    else
+        scalar_add(res->elems<float>(), a->elems<float>(),
+                    b->elems<float>(), a->get_size());
+    return res;
+}
+
+HomoVecObj *homo_mul(HomoVecObj *a, HomoVecObj *b) {
+    HomoVecObj *res = new HomoVecObj(a->get_kind(), a->get_size());
+    if (a->get_kind() == HOMO_F64)
+        f64_kernels().mul(res->elems<double>(), a->elems<double>(),
+                            b->elems<double>(), a->get_size());
+    else
+        scalar_mul(res->elems<float>(), a->elems<float>(),
+                    b->elems<float>(), a->get_size());
+    return res;
+}
+
+HomoVecObj *homo_scale(HomoVecObj *a, double k) {
+    HomoVecObj *res = new HomoVecObj(a->get_kind(), a->get_size());
+    if (a->get_kind() == HOMO_F64)
+        f64_kernels().scale(res->elems<double>(), a->elems<double>(),
+                            k, a->get_size());
+    else
+        scalar_scale(res->elems<float>(), a->elems<float>(),
+                    k, a->get_size());
+    return res;
+}
+
+double homo_dot(HomoVecObj *a, HomoVecObj *b) {
+    if (a->get_kind() == HOMO_F64)
+        return f64_kernels().dot(a->elems<double>(), b->elems<double>(),
+                                a->get_size());
+    return scalar_dot(a->elems<float>(), b->elems<float>(), a->get_size());
+}
+
+double homo_sum(HomoVecObj *a) {
+    if (a->get_kind() == HOMO_F64)
+        return f64_kernels().sum(a->elems<double>(), a->get_size());
+    return scalar_sum(a->elems<float>(), a->get_size());
+}
+
+double homo_min(HomoVecObj *a) {
+    if (a->get_kind() == HOMO_F64)
+        return f64_kernels().min(a->elems<double>(), a->get_size());
+    return scalar_min(a->elems<float>(), a->get_size());
+}
+
+double homo_max(HomoVecObj *a) {
+    if (a->get_kind() == HOMO_F64)
+        return f64_kernels().max(a->elems<double>(), a->get_size());
+    return scalar_max(a->elems<float>(), a->get_size());
+}
@@ -0,0 +1,90 @@
+#ifndef HOMOVEC_H
+#define HOMOVEC_H
+
+#include "types.h"
+#include <string>
+
+using std::string;
+
+const int CLS_HOMO_OBJ = 1 << 17;
+
+/** The element types of homogeneous vectors (SRFI-4) */
+enum HomoKind {
+    HOMO_U8,
+    HOMO_S8,
+    HOMO_U16,
+    HOMO_S16,
+    HOMO_U32,
+    HOMO_S32,
+    HOMO_U64,
+    HOMO_S64,
+    HOMO_F32,
+    HOMO_F64,
+    HOMO_KIND_NUM
+};
+
+/** The tags of the kinds, as in `f64vector` and `#f64(...)` */
+extern const char *HOMO_TAG[HOMO_KIND_NUM];
+/** The size in bytes of an element of each kind */
+extern const size_t HOMO_ELEM_SIZE[HOMO_KIND_NUM];
+
+/** Find the kind tagged by the `len` characters at `tag`
+ * @return -1 if there is no such kind */
+int homo_kind_of_tag(const char *tag, size_t len);
+
+/** Store `obj`, a number of the element type, as an element of `kind` in
+ * native byte order at `dst` */
+void homo_encode(HomoKind kind, EvalObj *obj, char *dst);
+/** Get the element of `kind` at `src` as a new number object */
+EvalObj *homo_decode(HomoKind kind, const char *src);
+
+/** @class HomoVecObj
+ * Homogeneous numeric vectors, whose elements are stored unboxed and
+ * contiguously. They hold no references, so the collector never scans
+ * them. The u8 vectors are also the bytevectors.
+ */
+class HomoVecObj: public EvalObj {/*{{{*/
+    private:
+        HomoKind kind;
+    public:
+        /** Storage implementation: the elements in native byte order */
+        string data;
+        /** Construct a vector of `size` zeros */
+        HomoVecObj(HomoKind kind, size_t size);
+        /** Construct from the raw elements in `data`, taking them over */
+        HomoVecObj(HomoKind kind, string data);
+        HomoKind get_kind();
+        /** Get the number of elements */
+        size_t get_size();
+        /** Get the element at `idx` as a new number object */
+        EvalObj *get(size_t idx);
+        /** Replace the element at `idx`, which must be a number of the
+         * element type */
+        void set(size_t idx, EvalObj *obj);
+        /** Set all elements to `obj` */
+        void fill(EvalObj *obj);
+        /** Get the elements as an array of `T` */
+        template<typename T> T *elems() {
+            return reinterpret_cast<T*>(&data[0]);
+        }
+        ReprCons *get_repr_cons();
+};/*}}}*/
+
+/** Test if `kind` holds inexact numbers, on which the bulk arithmetic
+ * operations below are defined */
+bool homo_is_float(HomoKind kind);
+
+/** Bulk arithmetic on vectors of a float kind. The operands of the same
+ * operation are of the same kind and size, and the f64 ones are handled
+ * with SSE2 or AVX2 depending on the CPU. Sums may be added in a different
+ * order from a plain loop. */
+HomoVecObj *homo_add(HomoVecObj *a, HomoVecObj *b);
+HomoVecObj *homo_mul(HomoVecObj *a, HomoVecObj *b);
+HomoVecObj *homo_scale(HomoVecObj *a, double k);
+double homo_dot(HomoVecObj *a, HomoVecObj *b);
+double homo_sum(HomoVecObj *a);
+/** The minimum and maximum of a non-empty vector */
+double homo_min(HomoVecObj *a);
+double homo_max(HomoVecObj *a);
+
+#endif
@@ -4,9 +4,14 @@
 #include "eval.h"
 #include "exc.h"
 #include "gc.h"
+#include "port.h"
 
 #include <cstdio>
 #include <cstdlib>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 GarbageCollector gc;
 Tokenizor tk;
@@ -20,7 +25,19 @@ void load_file(const char *fname) {
         printf("Can not open file: %s\n", fname);
         exit(0);
     }
-    tk.set_stream(f);
+    // map regular files into memory and let the tokenizor scan them
+    // directly, otherwise fall back to reading the stream by blocks
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    if (data != MAP_FAILED)
+    {
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        tk.set_buffer(static_cast<const char*>(data), st.st_size);
+    }
+    else
+        tk.set_stream(f);
     Pair *tree;
     while (1)
     {
@@ -33,10 +50,60 @@ void load_file(const char *fname) {
         }
         catch (GeneralError &e)
         {
+            flush_ports();
             fprintf(stderr, "An error occured: %s\n", e.get_msg().c_str());
         }
         gc.collect();
     }
+    if (data != MAP_FAILED)
+        munmap(data, st.st_size);
+    fclose(f);
+}
+
+/** Write the heap image of the top-level environment to `fname` */
+void dump_image(const char *fname) {
+    FILE *f = fopen(fname, "wb");
+    if (!f)
+    {
+        printf("Can not open file: %s\n", fname);
+        exit(0);
+    }
+    try
+    {
+        FileSink out(f);
+        eval.dump_image(out);
+        fclose(f);
+    }
+    catch (GeneralError &e)
+    {
+        fclose(f);
+        unlink(fname);      // do not leave a broken image
+        flush_ports();
+        fprintf(stderr, "An error occured: %s\n", e.get_msg().c_str());
+    }
+}
+
+/** Restore the top-level environment from the heap image in `fname` */
+void load_image(const char *fname) {
+    int fd = open(fname, O_RDONLY);
+    if (fd == -1)
+    {
+        printf("Can not open file: %s\n", fname);
+        exit(0);
+    }
+    InPortObj *port = new InPortObj(fd);
+    gc.attach(port);
+    try
+    {
+        eval.load_image(port);
+    }
+    catch (GeneralError &e)
+    {
+        flush_ports();
+        fprintf(stderr, "An error occured: %s\n", e.get_msg().c_str());
+    }
+    gc.expose(port);
+    gc.collect();
 }
 
 void print_help(const char *cmd) {
@@ -47,7 +114,10 @@ void print_help(const char *cmd) {
             "  FILE \t\tload Scheme source code from FILE, and exit\n"
             "The above switches stop argument processing\n\n"
             "  -l FILE \tload Scheme source code from FILE\n"
-            "  -h, --help \tdisplay this help and exit\n", cmd);
+            "  --dump-image FILE \tsave the top-level environment to FILE\n"
+            "  --image FILE \trestore the top-level environment from FILE\n"
+            "  -h, --help \tdisplay this help and exit\n",
+            cmd);
     exit(0);
 }
 
@@ -59,6 +129,7 @@ int main(int argc, char **argv) {
     //freopen("in.scm", "r", stdin);
     gc.attach(empty_list);
     gc.attach(unspec_obj);
+    init_ports();
 
     for (int i = 1; i < argc; i++)
     {
@@ -74,6 +145,22 @@ int main(int argc, char **argv) {
                     print_help(*argv);
                 }
             }
+            else if (strcmp(argv[i], "--dump-image") == 0 ||
+                    strcmp(argv[i], "--image") == 0)
+            {
+                if (i + 1 < argc)
+                {
+                    if (argv[i][2] == 'd')
+                        dump_image(argv[++i]);
+                    else
+                        load_image(argv[++i]);
+                }
+                else 
+                {
+                    printf("missing argument to `%s` switch\n", argv[i]);
+                    print_help(*argv);
+                }
+            }
             else if (strcmp(argv[i], "-h") == 0 ||
                     strcmp(argv[i], "--help") == 0)
                 print_help(*argv);
@@ -94,6 +181,7 @@ int main(int argc, char **argv) {
     tk.set_stream(stdin);  // interactive mode
     while (1)
     {
+        flush_ports();
         fprintf(stderr, "Sonsi> ");
         try
         {
@@ -102,10 +190,12 @@ int main(int argc, char **argv) {
             EvalObj *ret = eval.run_expr(tree);
             string output = ret->ext_repr();
             gc.expose(ret);
+            flush_ports();
             fprintf(stderr, "Ret> $%d = %s\n", rcnt++, output.c_str());
         }
         catch (GeneralError &e)
         {
+            flush_ports();
             fprintf(stderr, "An error occured: %s\n", e.get_msg().c_str());
         }
         gc.collect();
@@ -5,17 +5,10 @@
 #include "gc.h"
 
 #include <cstdio>
-#include <set>
+#include <vector>
 
-static const int REPR_STACK_SIZE = 262144;
 extern EmptyList *empty_list;
 extern GarbageCollector gc;
-typedef std::set<EvalObj*> EvalObjAddrHash;
-
-/** Maintain the current in-stack objects to detect circular structures */
-static EvalObjAddrHash hash;
-/** The stack for building external representation string */
-static ReprCons *repr_stack[REPR_STACK_SIZE];
 
 FrameObj::FrameObj(FrameType _ftype) : ftype(_ftype) {}
 
@@ -95,79 +88,104 @@ bool EvalObj::is_true() {
     return true;
 }
 
-string EvalObj::ext_repr() {
-    // TODO: Performance improvement
-    // (from possibly O(n^2logn) to strictly O(nlogn))
-    // O(n^2logn) because the potential string concatenate
-    // cost
-    hash.clear();
-    ReprCons **top_ptr = repr_stack;
-    *top_ptr++ = this->get_repr_cons();
-    EvalObj *obj;
-    hash.insert(this);
-    while (!(*repr_stack)->prim)
+/** Write a string as a literal which can be read back */
+static void write_str_literal(OutputSink &out, const char *ptr, size_t len) {
+    const char *end = ptr + len, *st = ptr;
+    out.put('"');
+    for (; ptr != end; ptr++)
     {
-        if ((*(top_ptr - 1))->prim)
+        const char *esc;
+        switch (*ptr)
         {
-            top_ptr -= 2;
-            obj = (*top_ptr)->next((*(top_ptr + 1))->repr);
-            delete *(top_ptr + 1);
-            if (obj)
-            {
-                *(++top_ptr) = obj->get_repr_cons();
-                EvalObj *ptr = (*top_ptr)->ori;
-                if (ptr)
-                {
-                    if (hash.count(ptr))
-                    {
-                        delete *top_ptr;
-                        *top_ptr = new ReprStr("#inf#");
-                    }
-                    else hash.insert(ptr);
-                }
-            }
-            else
-            {
-                hash.erase((*top_ptr)->ori);    // poping from stack
-                ReprCons *p = *top_ptr;
-                *top_ptr = new ReprStr(p->repr);
-                delete p;
-            }
+            case '"': esc = "\\\""; break;
+            case '\\': esc = "\\\\"; break;
+            case '\n': esc = "\\n"; break;
+            case '\t': esc = "\\t"; break;
+            default: continue;
         }
-        else
+        out.write(st, ptr - st);
+        out.write(esc, 2);
+        st = ptr + 1;
+    }
+    out.write(st, ptr - st);
+    out.put('"');
+}
+
+void EvalObj::write_repr(OutputSink &out, bool quote) {
+    // Non-recursive traversal, only the complex objects get a frame
+    ReprPath path;
+    std::vector<ReprCons*> repr_stack;
+    EvalObj *obj = this;
+    try
+    {
+        while (1)
         {
-            top_ptr--;
-            obj = (*top_ptr)->next("");
-            if (obj)
+            if (obj && obj->is_str_obj())
             {
-                *(++top_ptr) = obj->get_repr_cons();
-                EvalObj *ptr = (*top_ptr)->ori;
-                if (ptr)
+                StrObj *str = static_cast<StrObj*>(obj);
+                if (quote)
+                    write_str_literal(out, str->data(), str->length());
+                else
+                    out.write(str->data(), str->length());
+            }
+            else if (obj && !quote && (obj->get_otype() & CLS_CHAR_OBJ))
+                out.put(static_cast<CharObj*>(obj)->ch);
+            else if (obj)
+            {
+                ReprCons *rc = obj->get_repr_cons();
+                if (rc->prim)
                 {
-                    if (hash.count(ptr))
-                    {
-                        delete *top_ptr;
-                        *top_ptr = new ReprStr("#inf#");
-                    }
-                    else hash.insert(ptr);      // push into stack
+                    out.write(rc->repr);
+                    delete rc;
+                }
+                else if (path.count(rc->ori))
+                {
+                    delete rc;
+                    out.write("#inf#", 5);
+                }
+                else
+                {
+                    path.insert(rc->ori);       // push into stack
+                    repr_stack.push_back(rc);
                 }
             }
-            else
+            if (repr_stack.empty()) break;
+            ReprCons *top = repr_stack.back();
+            if (!(obj = top->next(out, path)))
             {
-                ReprCons *p = *top_ptr;
-                *top_ptr = new ReprStr(p->repr);
-                delete p;
+                path.erase(top->ori);           // poping from stack
+                repr_stack.pop_back();
+                delete top;
             }
         }
-        top_ptr++;
     }
-    string res = (*repr_stack)->repr;
-    if (this->is_pair_obj())
-        res = "(" + res + ")";
-    delete *repr_stack;
+    catch (...)
+    {
+        for (size_t i = 0; i < repr_stack.size(); i++)
+            delete repr_stack[i];
+        throw;
+    }
+}
+
+string EvalObj::ext_repr() {
+    string res;
+    StringSink out(res);
+    write_repr(out);
     return res;
 }
 
+StringSink::StringSink(string &_buff) : buff(_buff) {}
+
+void StringSink::write(const char *str, size_t len) {
+    buff.append(str, len);
+}
+
+FileSink::FileSink(FILE *_file) : file(_file) {}
+
+void FileSink::write(const char *str, size_t len) {
+    fwrite(str, 1, len, file);
+}
+
 ParseBracket::ParseBracket(unsigned char _btype) :
 FrameObj(CLS_SIM_OBJ | CLS_PAR_BRA), btype(_btype) {}
 
@@ -179,4 +197,4 @@ ReprCons *UnspecObj::get_repr_cons() {
 
 
 Container::Container(int otype, bool override) : 
-EvalObj(otype | (override ? 0 : CLS_CONTAINER)) {}
+EvalObj(otype | (override ? 0 : CLS_CONTAINER)), keep(false) {}
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <set>
+#include <unordered_set>
+#include <cstdio>
 
 using std::string;
 
@@ -48,9 +50,51 @@ class FrameObj {/*{{{*/
         bool is_parse_bracket();
 };/*}}}*/
 
+/** @class OutputSink
+ * The destination of a streamed external representation
+ */
+class OutputSink {/*{{{*/
+    public:
+        virtual ~OutputSink() {}
+        /** Write `len` bytes from `buff` */
+        virtual void write(const char *buff, size_t len) = 0;
+        /** Write a whole string */
+        void write(const string &str) { write(str.data(), str.length()); }
+        /** Write a single character */
+        void put(char ch) { write(&ch, 1); }
+};/*}}}*/
+
+/** @class StringSink
+ * Append the output to a string
+ */
+class StringSink : public OutputSink {/*{{{*/
+    private:
+        string &buff;
+    public:
+        /** Construct a sink appending to `buff` */
+        StringSink(string &buff);
+        void write(const char *buff, size_t len);
+};/*}}}*/
+
+/** @class FileSink
+ * Send the output to a (buffered) C stream
+ */
+class FileSink : public OutputSink {/*{{{*/
+    private:
+        FILE *file;
+    public:
+        /** Construct a sink writing to `file` */
+        FileSink(FILE *file);
+        void write(const char *buff, size_t len);
+};/*}}}*/
+
 class GCRecord;
 class Pair;
 class ReprCons;
+class EvalObj;
+/** The objects on the path being written, used to detect circular
+ * structures */
+typedef std::unordered_set<EvalObj*> ReprPath;
 /** @class EvalObj
  * Objects that represents a value in evaluation
  */
@@ -109,6 +153,10 @@ class EvalObj : public FrameObj {/*{{{*/
         virtual void prepare(Pair *pc);
         /** Any EvalObj has its external representation */
         string ext_repr();
+        /** Stream the external representation to `out`
+         * @param quote Write strings and characters as literals (as `write`
+         * does) */
+        void write_repr(OutputSink &out, bool quote = false);
         /** Always true for all other EvalObjs except BoolObj */
         virtual bool is_true();
         /** External representation construction, used by `ext_repr()` */
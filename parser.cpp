@@ -1,21 +1,75 @@
 #include <cstdio>
 #include <cctype>
 #include <sstream>
+#include <cstdlib>
+#include <charconv>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
 #include "parser.h"
 #include "exc.h"
 #include "consts.h"
 #include "builtin.h"
 #include "gc.h"
+#include "port.h"
+#include "homovec.h"
 
 using std::stringstream;
 
-static char buff[TOKEN_BUFF_SIZE];
 static FrameObj *parse_stack[PARSE_STACK_SIZE];
 extern Pair *empty_list;
 
-Tokenizor::Tokenizor() : stream(stdin), buff_ptr(buff), escaping(false) {}
+Tokenizor::Tokenizor() :
+stream(stdin), port(NULL),
+block(new char[TOKEN_BLOCK_SIZE]), ptr(block), end(block) {}
+
+Tokenizor::~Tokenizor() {
+    delete [] block;
+}
+
 void Tokenizor::set_stream(FILE *_stream) {
     stream = _stream;
+    port = NULL;
+    ptr = end = block;
+}
+
+void Tokenizor::set_buffer(const char *data, size_t size) {
+    stream = NULL;
+    port = NULL;
+    ptr = data;
+    end = data + size;
+}
+
+void Tokenizor::set_port(InPortObj *_port) {
+    stream = NULL;
+    port = _port;
+    ptr = port->ptr;
+    end = port->end;
+}
+
+void Tokenizor::release_port() {
+    port->ptr = ptr;
+}
+
+bool Tokenizor::refill() {
+    if (port)
+    {
+        port->ptr = end;
+        if (!port->refill()) return false;
+        ptr = port->ptr;
+        end = port->end;
+        return true;
+    }
+    if (!stream) return false;  // an in-memory buffer is never refilled
+    ssize_t size;
+    // read(2) returns whatever is available, so an interactive session is
+    // not blocked until the whole block is filled
+    do size = read(fileno(stream), block, TOKEN_BLOCK_SIZE);
+    while (size < 0 && errno == EINTR);
+    if (size <= 0) return false;
+    ptr = block;
+    end = block + size;
+    return true;
 }
 
 #define IS_NEWLINE(ch) \
@@ -35,105 +89,227 @@ void Tokenizor::set_stream(FILE *_stream) {
 #define IS_DELIMITER(ch) \
     (IS_BRACKET(ch) || IS_SPACE(ch) ||  \
      IS_COMMENT(ch) || IS_QUOTE(ch))
+/** Test if the atom of `len` characters at `st` opens a vector when
+ * followed by '(', as "#" and "#f64" do */
+#define IS_VECT_OPEN(st, len) \
+    (*(st) == '#' && \
+     ((len) == 1 || homo_kind_of_tag((st) + 1, (len) - 1) >= 0))
 
-#define POP \
-    do { \
-        *buff_ptr = 0; \
-        ret = string(buff); \
-        buff_ptr = buff; \
-    } while (0)
-#define TOP (*(buff_ptr - 1))
-
-string str_to_lower(string str) {
-    size_t len = str.length();
-    for (size_t i = 0; i < len; i++)
-        if ('A' <= str[i] && str[i] <= 'Z')
-            str[i] -= 'A' - 'a';
-    return str;
-}
-
-bool Tokenizor::get_token(string &ret) {
-    char ch;
-    bool flag = false;
-    while (fread(&ch, 1, 1, stream))
+bool Tokenizor::get_token(TokenView &ret) {
+    // skip spaces and comments
+    for (;;)
     {
-        if (escaping)
+        if (ptr == end && !refill()) return false;
+        if (IS_SPACE(*ptr)) ptr++;
+        else if (IS_COMMENT(*ptr))
         {
-            escaping = false;
-            switch (ch)
+            const void *nl;
+            while (!(nl = memchr(ptr, '\n', end - ptr)))
             {
-                case '\\': *buff_ptr++ = '\\'; break;
-                case '\"': *buff_ptr++ = '\"'; break;
-                case 'n': *buff_ptr++ = '\n'; break;
-                case 't': *buff_ptr++ = '\t'; break;
-                default: {
-                             buff_ptr = buff;
-                             throw TokenError(string("") + ch,
-                                     PAR_ERR_ILLEGAL_CHAR_IN_ESC);
-                         }
+                ptr = end;
+                if (!refill()) return false;
             }
+            ptr = static_cast<const char*>(nl) + 1;
         }
-        else
+        else break;
+    }
+
+    const char *st = ptr;
+    if (IS_BRACKET(*ptr) || IS_LITERAL(*ptr))
+    {
+        ret.ptr = ptr++;
+        ret.len = 1;
+        return true;
+    }
+
+    if (IS_QUOTE(*ptr))     // a string literal
+    {
+        for (ptr++; ptr != end && !IS_QUOTE(*ptr) && !IS_SLASH(*ptr); ptr++);
+        if (ptr != end && IS_QUOTE(*ptr))
+        {
+            ret.ptr = st;   // no escapes, just point to the input
+            ret.len = ++ptr - st;
+            return true;
+        }
+        // otherwise the escapes are translated in the spill buffer
+        spill.assign(st, ptr);
+        for (;;)
         {
-            bool in_quote = buff_ptr != buff && IS_QUOTE(*buff);
-            if (buff_ptr != buff)
+            if (ptr == end && !refill()) return false;
+            st = ptr;
+            while (ptr != end && !IS_QUOTE(*ptr) && !IS_SLASH(*ptr)) ptr++;
+            spill.append(st, ptr);
+            if (ptr == end) continue;
+            if (IS_QUOTE(*ptr++))
             {
-                if (buff_ptr - buff == 1 && IS_LITERAL(TOP))
-                {
-                    POP;
-                    flag = true;
-                }
-                else if ((IS_BRACKET(TOP) || IS_DELIMITER(ch)))
-                {
-                    if (IS_COMMENT(*buff))
-                    {
-                        if (IS_NEWLINE(ch)) buff_ptr = buff;
-                        else buff_ptr = buff + 1;
-                    }
-                    else if (!in_quote) // not in a double-quote
-                    {
-                        if (!(buff_ptr - buff == 1 && ch == '(' && TOP == '#'))
-                        {
-                            POP;
-                            flag = true;
-                        }
-                    }
-                    else if (IS_QUOTE(ch))
-                    {
-                        // in a double-quote which is being enclosed
-                        *buff_ptr++ = '\"';
-                        POP;
-                        return true;    // prevent duplicate quote sign
-                    }
-                }
+                spill += '\"';
+                break;
             }
-            if (in_quote || !IS_SPACE(ch))
+            if (ptr == end && !refill()) return false;
+            char ch = *ptr++;
+            switch (ch)
             {
-                if (in_quote && IS_SLASH(ch))
-                    escaping = true;
-                else
-                    *buff_ptr++ = ch;
+                case '\\': spill += '\\'; break;
+                case '\"': spill += '\"'; break;
+                case 'n': spill += '\n'; break;
+                case 't': spill += '\t'; break;
+                default:
+                          skip_string();
+                          throw TokenError(string("") + ch,
+                                  PAR_ERR_ILLEGAL_CHAR_IN_ESC);
             }
-            if (flag) return true;
         }
     }
-    if (buff_ptr != buff) POP;
-    return false; // can't read more
+    else                    // an atom
+    {
+        while (ptr != end && !IS_DELIMITER(*ptr)) ptr++;
+        if (ptr != end)
+        {
+            if (*ptr == '(' && IS_VECT_OPEN(st, ptr - st))
+                ptr++;      // the opening of a vector
+            ret.ptr = st;
+            ret.len = ptr - st;
+            return true;
+        }
+        // the atom may continue in the next block
+        spill.clear();
+        for (;;)
+        {
+            spill.append(st, ptr);
+            if (!refill()) break;
+            st = ptr;
+            while (ptr != end && !IS_DELIMITER(*ptr)) ptr++;
+            if (ptr != end)
+            {
+                spill.append(st, ptr);
+                break;
+            }
+        }
+        if (ptr != end && *ptr == '(' &&
+                IS_VECT_OPEN(spill.data(), spill.length()))
+            spill += *ptr++;
+    }
+    ret.ptr = spill.data();
+    ret.len = spill.length();
+    return true;
+}
+
+void Tokenizor::skip_string() {
+    bool escaping = false;
+    for (;; ptr++)
+    {
+        if (ptr == end && !refill()) return;
+        if (escaping) escaping = false;
+        else if (IS_SLASH(*ptr)) escaping = true;
+        else if (IS_QUOTE(*ptr)) break;
+    }
+    ptr++;
 }
 
 ASTGenerator::ASTGenerator() {}
 
 
-EvalObj *ASTGenerator::to_obj(const string &str) {
+#define IS_DIGIT(ch) \
+    ('0' <= (ch) && (ch) <= '9')
+
+NumObj *str_to_num(const char *ptr, size_t len) {
+    const char *end = ptr + len, *p = ptr;
+    if (p == end) return NULL;
+    // complex numbers are rare, leave them to the general routine
+    if (*(end - 1) == 'i' || *(end - 1) == 'I')
+        return CompNumObj::from_string(string(ptr, len));
+
+    bool neg = false;
+    if (*p == '+' || *p == '-') neg = *p++ == '-';
+    if (p != ptr && end - p == 5 && (p[0] == 'i' || p[0] == 'n'))
+    {
+        // +inf.0, -inf.0 and +nan.0
+        bool flag;
+        double val = str_to_double(ptr, len, flag);
+        return flag ? new RealNumObj(val) : NULL;
+    }
+    const char *ds = p;             // the start of digits
+    while (p != end && IS_DIGIT(*p)) p++;
+    size_t nint = p - ds;
+
+    if (p == end)                   // an integer
+    {
+        if (!nint) return NULL;
+        if (nint <= MAX_FIXED_DIGITS)
+        {
+            long val = 0;
+            std::from_chars(ds, end, val);
+            return new IntNumObj(neg ? -val : val);
+        }
+        mpz_class val(string(ds, nint), 10);
+        if (neg) val = -val;
+        return new IntNumObj(val);
+    }
+
+    if (*p == '/')                  // a rational
+    {
+        const char *dd = ++p;
+        while (p != end && IS_DIGIT(*p)) p++;
+        if (!nint || p == dd || p != end) return NULL;
+        return RatNumObj::from_string(neg ? "-" + string(ds, end) :
+                                            string(ds, end));
+    }
+
+    size_t nfrac = 0;               // a decimal
+    if (*p == '.')
+    {
+        const char *fs = ++p;
+        while (p != end && IS_DIGIT(*p)) p++;
+        nfrac = p - fs;
+    }
+    if (!nint && !nfrac) return NULL;
+    if (p != end && (*p == 'e' || *p == 'E'))
+    {
+        if (++p != end && (*p == '+' || *p == '-')) p++;
+        const char *es = p;
+        while (p != end && IS_DIGIT(*p)) p++;
+        if (p == es) return NULL;
+    }
+    if (p != end) return NULL;
+
+    double val;
+    std::from_chars_result fr = std::from_chars(ds, end, val);
+    if (fr.ec != std::errc() || fr.ptr != end)     // out of range
+        val = strtod(string(ds, end).c_str(), NULL);
+    return new RealNumObj(neg ? -val : val);
+}
+
+EvalObj *ASTGenerator::to_obj(const TokenView &tok) {
     EvalObj *res = NULL;
-    if ((res = BoolObj::from_string(str))) return res;
-    if ((res = CharObj::from_string(str))) return res;
-    if ((res = IntNumObj::from_string(str))) return res;
-    if ((res = RatNumObj::from_string(str))) return res;
-    if ((res = RealNumObj::from_string(str))) return res;
-    if ((res = CompNumObj::from_string(str))) return res;
-    if ((res = StrObj::from_string(str))) return res;
-    return new SymObj(str_to_lower(str)); // otherwise we assume it a symbol
+    const char *str = tok.ptr;
+    size_t len = tok.len;
+    // decide the lexical category by the leading character, so that no
+    // constructor is probed in vain
+    switch (str[0])
+    {
+        case '\"':
+            if (len > 1 && str[len - 1] == '\"')
+                return new StrObj(string(str + 1, len - 2));
+            break;
+        case '#':
+            if (len == 2 && (str[1] == 't' || str[1] == 'f'))
+                return new BoolObj(str[1] == 't');
+            if (len == 3 && str[1] == '\\')
+                return new CharObj(str[2]);
+            if ((res = CharObj::from_string(string(str, len)))) return res;
+            break;
+        case '+': case '-': case '.':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            if ((res = str_to_num(str, len))) return res;
+            break;
+    }
+    // otherwise we assume it a symbol
+    SymObj *sym = new SymObj(str, len);
+    for (string::iterator it = sym->val.begin(); it != sym->val.end(); it++)
+        if ('A' <= *it && *it <= 'Z')
+            *it -= 'A' - 'a';
+    return sym;
 }
 
 #define TO_EVAL(ptr) \
@@ -142,48 +318,94 @@ EvalObj *ASTGenerator::to_obj(const string &str) {
     (static_cast<ParseBracket*>(ptr))
 #define IS_BRAKET(ptr) \
     ((ptr)->is_parse_bracket())
+#define IS_DOT(obj) \
+    ((obj)->is_sym_obj() && static_cast<SymObj*>(obj)->val == ".")
+
+/** Markers of '(', '#(' and '\'' in the parse stack, shared by all frames */
+static ParseBracket bracket_list(0), bracket_vect(1), bracket_quote(2);
+/** Markers of '#u8(', '#f64(', etc., whose types follow the ones above */
+static const unsigned char BRACKET_HOMO = 3;
+static ParseBracket bracket_homo[HOMO_KIND_NUM] = {
+    BRACKET_HOMO + HOMO_U8, BRACKET_HOMO + HOMO_S8,
+    BRACKET_HOMO + HOMO_U16, BRACKET_HOMO + HOMO_S16,
+    BRACKET_HOMO + HOMO_U32, BRACKET_HOMO + HOMO_S32,
+    BRACKET_HOMO + HOMO_U64, BRACKET_HOMO + HOMO_S64,
+    BRACKET_HOMO + HOMO_F32, BRACKET_HOMO + HOMO_F64
+};
 
 Pair *ASTGenerator::absorb(Tokenizor *tk) {
     FrameObj **top_ptr = parse_stack;
+    TokenView token;
     for (;;)
     {
         if (top_ptr == parse_stack + PARSE_STACK_SIZE)
             throw TokenError("Parser", RUN_ERR_STACK_OVERFLOW);
 
-        if (top_ptr - parse_stack > 1 &&
+        // fold every quote whose datum is complete, as in ''a
+        while (top_ptr - parse_stack > 1 &&
                 !IS_BRAKET(*(top_ptr - 1)) &&
-                IS_BRAKET(*(top_ptr - 2)))
+                *(top_ptr - 2) == &bracket_quote)
         {
-            ParseBracket *bptr = TO_BRACKET(*(top_ptr - 2));
-            if (bptr->btype == 2)
-            {
-                top_ptr -= 2;
-                Pair *lst_cdr = new Pair(TO_EVAL(*(top_ptr + 1)), empty_list);
-                Pair *lst = new Pair(new SymObj("quote"), lst_cdr);
-                *top_ptr++ = lst;
-            }
+            top_ptr -= 2;
+            Pair *lst_cdr = new Pair(TO_EVAL(*(top_ptr + 1)), empty_list);
+            Pair *lst = new Pair(new SymObj("quote"), lst_cdr);
+            *top_ptr++ = lst;
         }
 
         if (top_ptr > parse_stack && !IS_BRAKET(*parse_stack))
             return new Pair(TO_EVAL(*(top_ptr - 1)), empty_list);
-        string token;
         if (!tk->get_token(token)) return NULL;
-        if (token == "(")       // a list
-            *top_ptr++ = new ParseBracket(0);
-        else if (token == "#(") // a vector
-            *top_ptr++ = new ParseBracket(1);
-        else if (token == "\'") // syntatic sugar for quote
-            *top_ptr++ = new ParseBracket(2);
-        else if (token == ")")
+        char ch = *token.ptr;
+        if (token.len == 1 && ch == '(')        // a list
+            *top_ptr++ = &bracket_list;
+        else if (token.len == 2 && ch == '#' && token.ptr[1] == '(')
+            *top_ptr++ = &bracket_vect;         // a vector
+        else if (token.len > 2 && ch == '#' && token.ptr[token.len - 1] == '(')
+            *top_ptr++ = &bracket_homo[         // a homogeneous vector
+                homo_kind_of_tag(token.ptr + 1, token.len - 2)];
+        else if (token.len == 1 && ch == '\'')  // syntatic sugar for quote
+            *top_ptr++ = &bracket_quote;
+        else if (token.len == 1 && ch == ')')
         {
             if (top_ptr == parse_stack)
                 throw NormalError(READ_ERR_UNEXPECTED_RIGHT_BRACKET);
+            FrameObj **bptr = top_ptr;
+            while (!IS_BRAKET(*(--bptr)));
+            if (*bptr == &bracket_vect)
+            {
+                // fill the vector directly from the stack
+                VecObj *vec = new VecObj();
+                vec->vec.reserve(top_ptr - bptr - 1);
+                for (FrameObj **p = bptr + 1; p != top_ptr; p++)
+                {
+                    if (IS_DOT(TO_EVAL(*p)))
+                        throw NormalError(PAR_ERR_IMPROPER_VECT);
+                    vec->push_back(TO_EVAL(*p));
+                }
+                top_ptr = bptr;
+                *top_ptr++ = vec;
+                continue;
+            }
+            if (TO_BRACKET(*bptr)->btype >= BRACKET_HOMO)
+            {
+                HomoKind kind =
+                    HomoKind(TO_BRACKET(*bptr)->btype - BRACKET_HOMO);
+                HomoVecObj *vec = new HomoVecObj(kind, top_ptr - bptr - 1);
+                for (FrameObj **p = bptr + 1; p != top_ptr; p++)
+                {
+                    vec->set(p - bptr - 1, TO_EVAL(*p));
+                    delete *p;  // the elements are stored unboxed
+                }
+                top_ptr = bptr;
+                *top_ptr++ = vec;
+                continue;
+            }
             EvalObj *lst = empty_list;
             bool improper = false;
-            while (top_ptr >= parse_stack && !IS_BRAKET(*(--top_ptr)))
+            while (--top_ptr != bptr)
             {
                 EvalObj *obj = TO_EVAL(*top_ptr);
-                if (obj->is_sym_obj() && static_cast<SymObj*>(obj)->val == ".")
+                if (IS_DOT(obj))
                 {
                     if (improper ||
                             lst == empty_list ||
@@ -201,19 +423,7 @@ Pair *ASTGenerator::absorb(Tokenizor *tk) {
                     lst = _lst;
                 }
             }
-
-            ParseBracket *bptr = TO_BRACKET(*top_ptr);
-            if (bptr->btype == 0)
-                *top_ptr++ = lst;
-            else if (bptr->btype == 1)
-            {
-                if (improper) throw NormalError(PAR_ERR_IMPROPER_VECT);
-                VecObj *vec = new VecObj();
-                for (Pair *ptr = TO_PAIR(lst); ptr != empty_list; ptr = TO_PAIR(ptr->cdr))
-                    vec->push_back(ptr->car);
-                *top_ptr++ = vec;
-                if (lst != empty_list) delete lst;
-            }
+            *top_ptr++ = lst;
         }
         else
             *top_ptr++ = ASTGenerator::to_obj(token);
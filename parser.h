@@ -6,8 +6,21 @@
 
 using std::string;
 
-const int TOKEN_BUFF_SIZE = 65536;
+const int TOKEN_BLOCK_SIZE = 65536;
 const int PARSE_STACK_SIZE = 262144;
+/** Integer literals with at most this many digits are read without GMP */
+const size_t MAX_FIXED_DIGITS = 18;
+
+/** @class TokenView
+ * A token, which points into the input buffer whenever possible. It is only
+ * valid until the next token is extracted.
+ */
+struct TokenView {
+    const char *ptr;    /**< The first character of the token */
+    size_t len;         /**< The length of the token */
+};
+
+class InPortObj;
 
 /** @class Tokenizor
  * Break down the input string stream into tokens
@@ -15,18 +28,42 @@ const int PARSE_STACK_SIZE = 262144;
 class Tokenizor {
     private:
         FILE *stream;
-        char *buff_ptr;
-        bool escaping;
+        /** The input port being read, if any */
+        InPortObj *port;
+        /** The block buffer for reading from the stream */
+        char *block;
+        /** The scanning pointer */
+        const char *ptr;
+        /** The end of the data available */
+        const char *end;
+        /** Holds the token being assembled when it can not be pointed to
+         * in place (it crosses blocks or contains escapes) */
+        string spill;
+        /** Read the next block from the stream
+         * @return false if nothing can be read further
+         */
+        bool refill();
+        /** Skip the remaining part of a broken string literal */
+        void skip_string();
     public:
         Tokenizor();
+        ~Tokenizor();
         /** Set the stream to be read from (without setting this, the default
          * would be stdin) */
         void set_stream(FILE *stream);
+        /** Read from an in-memory buffer (e.g. a mapped file) instead of a
+         * stream */
+        void set_buffer(const char *data, size_t size);
+        /** Read from the unread data of an input port, refilling it when
+         * needed. Call `release_port` to hand the position back. */
+        void set_port(InPortObj *port);
+        /** Update the position of the port to what has been consumed */
+        void release_port();
         /** Extract the next token
          * @param ret the extracted token
          * @return false if nothing can be read further
          * */
-        bool get_token(string &ret);
+        bool get_token(TokenView &ret);
 };
 
 /** @class ASTGenerator
@@ -35,8 +72,8 @@ class Tokenizor {
  */
 class ASTGenerator {
     private:
-        /** Convert the string to an internal object */
-        static EvalObj* to_obj(const string &);
+        /** Convert the token to an internal object */
+        static EvalObj* to_obj(const TokenView &tok);
     public:
         ASTGenerator();
         /** Read tokens from Tokenizor tk, then return a AST
@@ -46,4 +83,10 @@ class ASTGenerator {
         Pair *absorb(Tokenizor *tk);
 };
 
+class NumObj;
+/** Read a numeric literal in a single pass
+ * @return NULL if the string is not a number
+ */
+NumObj *str_to_num(const char *ptr, size_t len);
+
 #endif
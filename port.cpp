@@ -0,0 +1,252 @@
+#include "port.h"
+#include "types.h"
+#include "exc.h"
+#include "gc.h"
+
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+extern GarbageCollector gc;
+
+OutPortObj *stdout_port = NULL;
+OutPortObj *cur_out_port = NULL;
+EofObj *eof_obj = NULL;
+static InPortObj *stdin_port = NULL;
+/** The most recently opened port writing to a descriptor */
+static OutPortObj *live_ports = NULL;
+
+OutPortObj::OutPortObj(int otype, int _fd, BufferMode _mode, bool _owned) :
+EvalObj(otype | CLS_SIM_OBJ | CLS_PORT_OBJ | CLS_OUT_PORT),
+fd(_fd), owned(_owned), mode(_mode), buff(NULL), len(0),
+prev_live(NULL), next_live(NULL), closed(false) {
+    if (fd < 0) return;
+    if ((next_live = live_ports))
+        next_live->prev_live = this;
+    live_ports = this;
+}
+
+OutPortObj::OutPortObj(int _fd, BufferMode _mode, bool _owned) :
+OutPortObj(0, _fd, _mode, _owned) {}
+
+OutPortObj::~OutPortObj() {
+    close();
+    delete [] buff;
+}
+
+void OutPortObj::write_fd(const char *data, size_t size) {
+    while (size)
+    {
+        ssize_t ret = ::write(fd, data, size);
+        if (ret < 0)
+        {
+            if (errno == EINTR) continue;
+            return;             // the output is lost, just like stdio
+        }
+        data += ret;
+        size -= ret;
+    }
+}
+
+void OutPortObj::write(const char *data, size_t size) {
+    if (closed) throw NormalError(RUN_ERR_PORT_CLOSED);
+    if (mode == BUF_NONE)
+    {
+        write_fd(data, size);
+        return;
+    }
+    if (len + size > PORT_BUFF_SIZE)
+    {
+        flush();
+        if (size >= PORT_BUFF_SIZE)     // too large to be buffered
+        {
+            write_fd(data, size);
+            return;
+        }
+    }
+    if (!buff) buff = new char[PORT_BUFF_SIZE];
+    memcpy(buff + len, data, size);
+    len += size;
+    if (mode == BUF_LINE && memchr(data, '\n', size))
+        flush();
+}
+
+void OutPortObj::flush() {
+    if (!len) return;
+    write_fd(buff, len);
+    len = 0;
+}
+
+void OutPortObj::set_mode(BufferMode _mode) {
+    flush();
+    mode = _mode;
+}
+
+void OutPortObj::close() {
+    if (closed) return;
+    flush();
+    closed = true;
+    if (fd >= 0)
+    {
+        if (prev_live) prev_live->next_live = next_live;
+        else live_ports = next_live;
+        if (next_live) next_live->prev_live = prev_live;
+    }
+    if (owned) ::close(fd);
+}
+
+ReprCons *OutPortObj::get_repr_cons() {
+    return new ReprStr("#<Output Port>");
+}
+
+StrOutPortObj::StrOutPortObj() :
+OutPortObj(CLS_STR_PORT, -1, BUF_NONE, false) {}
+
+void StrOutPortObj::write(const char *data, size_t size) {
+    if (closed) throw NormalError(RUN_ERR_PORT_CLOSED);
+    text.append(data, size);
+}
+
+ReprCons *StrOutPortObj::get_repr_cons() {
+    return new ReprStr("#<String Port>");
+}
+
+InPortObj::InPortObj(int _fd, bool _owned) :
+EvalObj(CLS_SIM_OBJ | CLS_PORT_OBJ | CLS_IN_PORT),
+fd(_fd), owned(_owned), closed(false), block(NULL),
+map(MAP_FAILED), map_size(0), ptr(NULL), end(NULL) {
+    struct stat st;
+    off_t offset;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        (offset = lseek(fd, 0, SEEK_CUR)) >= 0)
+    {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            map_size = st.st_size;
+            ptr = static_cast<const char*>(map) + offset;
+            end = static_cast<const char*>(map) + map_size;
+            if (ptr > end) ptr = end;
+            return;
+        }
+    }
+    block = new char[PORT_BUFF_SIZE];
+}
+
+InPortObj::~InPortObj() {
+    close();
+}
+
+void InPortObj::check_open() {
+    if (closed) throw NormalError(RUN_ERR_PORT_CLOSED);
+}
+
+bool InPortObj::refill() {
+    check_open();
+    if (!block) return false;   // the whole file is already in the window
+    ssize_t ret;
+    while ((ret = ::read(fd, block, PORT_BUFF_SIZE)) < 0 && errno == EINTR);
+    if (ret <= 0) return false;
+    ptr = block;
+    end = block + ret;
+    return true;
+}
+
+size_t InPortObj::get_remaining() {
+    return block ? SIZE_MAX : end - ptr;
+}
+
+int InPortObj::read_char() {
+    check_open();
+    if (ptr == end && !refill()) return EOF;
+    return (unsigned char)*ptr++;
+}
+
+int InPortObj::peek_char() {
+    check_open();
+    if (ptr == end && !refill()) return EOF;
+    return (unsigned char)*ptr;
+}
+
+bool InPortObj::read_line(string &line) {
+    check_open();
+    bool got = false;
+    line.clear();
+    for (;;)
+    {
+        if (ptr == end && !refill()) return got;
+        const char *nl = static_cast<const char*>(memchr(ptr, '\n', end - ptr));
+        if (nl)
+        {
+            line.append(ptr, nl);
+            ptr = nl + 1;
+            return true;
+        }
+        line.append(ptr, end);
+        ptr = end;
+        got = true;
+    }
+}
+
+bool InPortObj::read_string(string &res, size_t size) {
+    check_open();
+    bool got = false;
+    res.clear();
+    while (size)
+    {
+        if (ptr == end && !refill()) return got;
+        size_t len = end - ptr;
+        if (len > size) len = size;
+        res.append(ptr, len);
+        ptr += len;
+        size -= len;
+        got = true;
+    }
+    return true;
+}
+
+void InPortObj::close() {
+    if (closed) return;
+    closed = true;
+    if (map != MAP_FAILED) munmap(map, map_size);
+    delete [] block;
+    block = NULL;
+    ptr = end = NULL;
+    if (owned) ::close(fd);
+}
+
+ReprCons *InPortObj::get_repr_cons() {
+    return new ReprStr("#<Input Port>");
+}
+
+EofObj::EofObj() : EvalObj(CLS_SIM_OBJ) {}
+
+ReprCons *EofObj::get_repr_cons() {
+    return new ReprStr("#<eof>");
+}
+
+InPortObj *get_stdin_port() {
+    if (!stdin_port)
+        gc.attach(stdin_port = new InPortObj(STDIN_FILENO, false));
+    return stdin_port;
+}
+
+void init_ports() {
+    stdout_port = new OutPortObj(STDOUT_FILENO,
+                            isatty(STDOUT_FILENO) ? BUF_LINE : BUF_FULL);
+    gc.attach(stdout_port);
+    cur_out_port = stdout_port;
+    gc.attach(eof_obj = new EofObj());
+    atexit(flush_ports);
+}
+
+void flush_ports() {
+    for (OutPortObj *port = live_ports; port; port = port->next_live)
+        port->flush();
+}
@@ -0,0 +1,147 @@
+#ifndef PORT_H
+#define PORT_H
+
+#include "model.h"
+
+#include <string>
+
+using std::string;
+
+const int CLS_PORT_OBJ = 1 << 11;
+const int CLS_OUT_PORT = 1 << 12;
+const int CLS_IN_PORT = 1 << 13;
+const int CLS_STR_PORT = 1 << 18;
+
+/** The size of the buffer of an output port */
+const size_t PORT_BUFF_SIZE = 65536;
+
+/** The buffering policy of an output port */
+enum BufferMode {
+    BUF_NONE,   /**< Write through on every call */
+    BUF_LINE,   /**< Flush when a newline is written */
+    BUF_FULL    /**< Flush when the buffer is full */
+};
+
+/** @class OutPortObj
+ * An output port writing to a file descriptor through its own buffer
+ */
+class OutPortObj : public EvalObj, public OutputSink {/*{{{*/
+    private:
+        int fd;                 /**< The file descriptor to write to */
+        bool owned;             /**< Close the descriptor when closing */
+        BufferMode mode;        /**< The buffering policy */
+        char *buff;             /**< The buffer, allocated on demand */
+        size_t len;             /**< The amount of pending bytes */
+        /** The neighbours in the list of the open ports writing to a
+         * descriptor, which are all flushed on exit */
+        OutPortObj *prev_live, *next_live;
+        /** Write all `size` bytes to the descriptor */
+        void write_fd(const char *data, size_t size);
+        friend void flush_ports();
+    protected:
+        bool closed;
+        /** Construct a port of the type `otype` writing to `fd` */
+        OutPortObj(int otype, int fd, BufferMode mode, bool owned);
+    public:
+        /** Construct an output port writing to `fd` */
+        OutPortObj(int fd, BufferMode mode, bool owned = false);
+        /** Flush the pending output */
+        ~OutPortObj();
+        void write(const char *data, size_t size);
+        /** Send all pending output to the descriptor */
+        void flush();
+        /** Change the buffering policy (pending output is flushed) */
+        void set_mode(BufferMode mode);
+        /** Flush and release the file */
+        void close();
+        ReprCons *get_repr_cons();
+};/*}}}*/
+
+/** @class StrOutPortObj
+ * An output port collecting the output in a string, which also serves as
+ * the string builder. Objects are written to it through their
+ * representation, so appending takes amortized time linear in the size of
+ * the output.
+ */
+class StrOutPortObj : public OutPortObj {/*{{{*/
+    public:
+        /** The output so far */
+        string text;
+        /** Construct an empty port */
+        StrOutPortObj();
+        void write(const char *data, size_t size);
+        ReprCons *get_repr_cons();
+};/*}}}*/
+
+/** @class InPortObj
+ * An input port. Regular files are mapped into memory as a whole, other
+ * files (pipes, terminals) are read block by block. The unread data is
+ * always available as the window [ptr, end).
+ */
+class InPortObj : public EvalObj {/*{{{*/
+    private:
+        int fd;                 /**< The file descriptor to read from */
+        bool owned;             /**< Close the descriptor when closing */
+        bool closed;
+        char *block;            /**< The buffer for non-mapped files */
+        void *map;              /**< The mapped file */
+        size_t map_size;
+        /** Throw an error if the port is closed */
+        void check_open();
+    public:
+        const char *ptr;        /**< The next unread byte */
+        const char *end;        /**< The end of the available data */
+        /** Construct an input port reading from `fd` */
+        InPortObj(int fd, bool owned = true);
+        ~InPortObj();
+        /** Make more data available in the window
+         * @return false on the end of file */
+        bool refill();
+        /** Read a byte, EOF on the end of file */
+        int read_char();
+        /** Get the next byte without consuming it, EOF on the end of file */
+        int peek_char();
+        /** Read a line without the trailing newline
+         * @return false on the end of file */
+        bool read_line(string &line);
+        /** Read at most `size` bytes
+         * @return false on the end of file */
+        bool read_string(string &res, size_t size);
+        /** Get the number of unread bytes, which is only known if the
+         * whole file is mapped
+         * @return SIZE_MAX if unknown */
+        size_t get_remaining();
+        /** Release the file */
+        void close();
+        ReprCons *get_repr_cons();
+};/*}}}*/
+
+/** @class EofObj
+ * The end-of-file object
+ */
+class EofObj : public EvalObj {/*{{{*/
+    public:
+        EofObj();
+        ReprCons *get_repr_cons();
+};/*}}}*/
+
+/** The port attached to the standard output, line buffered on a terminal
+ * and fully buffered otherwise */
+extern OutPortObj *stdout_port;
+/** The port used by output procedures when no port is given */
+extern OutPortObj *cur_out_port;
+
+/** The end-of-file object returned by the input procedures */
+extern EofObj *eof_obj;
+
+/** Get the port attached to the standard input (created on demand, since
+ * the REPL reads the standard input on its own) */
+InPortObj *get_stdin_port();
+
+/** Create the standard ports */
+void init_ports();
+/** Flush all open ports writing to a descriptor, called before exiting
+ * and before writing to stderr so that the output is kept in order */
+void flush_ports();
+
+#endif
@@ -0,0 +1,151 @@
+#include "record.h"
+#include "exc.h"
+#include "consts.h"
+
+#include <new>
+
+extern EmptyList *empty_list;
+extern UnspecObj *unspec_obj;
+
+RecordTypeObj::RecordTypeObj(const string &_name,
+        const std::vector<string> &_fields) :
+EvalObj(CLS_SIM_OBJ | CLS_RECORD_TYPE_OBJ), name(_name), fields(_fields) {}
+
+const string &RecordTypeObj::get_name() { return name; }
+
+const std::vector<string> &RecordTypeObj::get_fields() { return fields; }
+
+size_t RecordTypeObj::get_size() { return fields.size(); }
+
+ReprCons *RecordTypeObj::get_repr_cons() {
+    return new ReprStr("#<Record Type: " + name + ">");
+}
+
+RecordObj::RecordObj(RecordTypeObj *_type) :
+Container(CLS_SIM_OBJ | CLS_RECORD_OBJ), type(_type),
+    slots(reinterpret_cast<EvalObj**>(this + 1)) {
+    gc.attach(type);
+    for (size_t i = 0; i < type->get_size(); i++)
+        slots[i] = gc.attach(unspec_obj);
+}
+
+RecordObj *RecordObj::make(RecordTypeObj *type) {
+    void *mem = ::operator new(sizeof(RecordObj) +
+                                type->get_size() * sizeof(EvalObj*));
+    return new (mem) RecordObj(type);
+}
+
+void RecordObj::operator delete(void *ptr) {
+    ::operator delete(ptr);
+}
+
+RecordObj::~RecordObj() {
+    for (size_t i = 0; i < type->get_size(); i++)
+        gc.expose(slots[i]);
+    gc.expose(type);
+}
+
+RecordTypeObj *RecordObj::get_type() { return type; }
+
+EvalObj *RecordObj::get(size_t idx) { return slots[idx]; }
+
+void RecordObj::set(size_t idx, EvalObj *obj) {
+    gc.expose(slots[idx]);
+    slots[idx] = gc.attach(obj);
+}
+
+ReprCons *RecordObj::get_repr_cons() {
+    return new ReprStr("#<Record: " + type->get_name() + ">");
+}
+
+void RecordObj::gc_decrement() {
+    for (size_t i = 0; i < type->get_size(); i++)
+        GC_CYC_DEC(slots[i]);
+}
+
+void RecordObj::gc_trigger(EvalObj ** &tail) {
+    for (size_t i = 0; i < type->get_size(); i++)
+        GC_CYC_TRIGGER(slots[i]);
+}
+
+RecordOptObj::RecordOptObj(RecordOptKind _kind, RecordTypeObj *_type,
+        const string &_name, size_t _slot) :
+OptObj(CLS_RECORD_OPT_OBJ), kind(_kind), type(_type), name(_name),
+    slot(_slot) {
+    gc.attach(type);
+}
+
+RecordOptObj::RecordOptObj(RecordTypeObj *_type, const string &_name,
+        const std::vector<size_t> &_inits) :
+OptObj(CLS_RECORD_OPT_OBJ), kind(RECORD_CONSTRUCTOR), type(_type),
+    name(_name), slot(0), inits(_inits) {
+    gc.attach(type);
+}
+
+RecordOptObj::~RecordOptObj() {
+    gc.expose(type);
+}
+
+RecordOptKind RecordOptObj::get_kind() { return kind; }
+
+RecordTypeObj *RecordOptObj::get_type() { return type; }
+
+const string &RecordOptObj::get_name() { return name; }
+
+size_t RecordOptObj::get_slot() { return slot; }
+
+const std::vector<size_t> &RecordOptObj::get_inits() { return inits; }
+
+RecordObj *RecordOptObj::to_record(EvalObj *obj) {
+    if (!(obj->get_otype() & CLS_RECORD_OBJ) ||
+            static_cast<RecordObj*>(obj)->get_type() != type)
+        throw TokenError("a " + type->get_name() + " record",
+                        RUN_ERR_WRONG_TYPE);
+    return static_cast<RecordObj*>(obj);
+}
+
+Pair *RecordOptObj::call(Pair *args, Environment * &lenvt,
+        Continuation * &cont, EvalObj ** &top_ptr, Pair *pc) {
+    Pair *ret_addr = cont->pc;
+    Pair *ptr = TO_PAIR(args->cdr);
+    EvalObj *res;
+    size_t nargs = kind == RECORD_CONSTRUCTOR ? inits.size() :
+                    kind == RECORD_MODIFIER ? 2 : 1;
+    // check the number of arguments before anything is made
+    for (size_t i = 0; i < nargs; i++, ptr = TO_PAIR(ptr->cdr))
+        if (ptr == empty_list)
+            throw TokenError(name, RUN_ERR_WRONG_NUM_OF_ARGS);
+    if (ptr != empty_list)
+        throw TokenError(name, RUN_ERR_WRONG_NUM_OF_ARGS);
+    ptr = TO_PAIR(args->cdr);
+    switch (kind)
+    {
+        case RECORD_CONSTRUCTOR:
+            {
+                RecordObj *rec = RecordObj::make(type);
+                for (size_t i = 0; i < inits.size();
+                        i++, ptr = TO_PAIR(ptr->cdr))
+                    rec->set(inits[i], ptr->car);
+                res = rec;
+                break;
+            }
+        case RECORD_PREDICATE:
+            res = new BoolObj((ptr->car->get_otype() & CLS_RECORD_OBJ) &&
+                        static_cast<RecordObj*>(ptr->car)->get_type() == type);
+            break;
+        case RECORD_ACCESSOR:
+            res = to_record(ptr->car)->get(slot);
+            break;
+        default:
+            to_record(ptr->car)->set(slot, TO_PAIR(ptr->cdr)->car);
+            res = unspec_obj;
+    }
+    gc.expose(*top_ptr);
+    *top_ptr++ = gc.attach(res);
+    EXIT_CURRENT_EXEC(lenvt, cont, args);
+    return ret_addr->next;          // Move to the next instruction
+}
+
+ReprCons *RecordOptObj::get_repr_cons() {
+    return new ReprStr("#<Record Procedure: " + name + ">");
+}
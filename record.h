@@ -0,0 +1,103 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include "types.h"
+#include "gc.h"
+#include <string>
+#include <vector>
+
+using std::string;
+
+const int CLS_RECORD_OBJ = 1 << 19;
+const int CLS_RECORD_TYPE_OBJ = 1 << 21;
+const int CLS_RECORD_OPT_OBJ = 1 << 22;
+
+/** @class RecordTypeObj
+ * The descriptor shared by all records of a type defined with
+ * `define-record-type`
+ */
+class RecordTypeObj: public EvalObj {/*{{{*/
+    private:
+        string name;
+        /** The field names, in the order of the slots */
+        std::vector<string> fields;
+    public:
+        RecordTypeObj(const string &name, const std::vector<string> &fields);
+        const string &get_name();
+        const std::vector<string> &get_fields();
+        /** Get the number of slots of a record */
+        size_t get_size();
+        ReprCons *get_repr_cons();
+};/*}}}*/
+
+/** @class RecordObj
+ * A record, whose slots are laid out right after the object itself, so a
+ * field is reached without any lookup or extra indirection
+ */
+class RecordObj: public Container {/*{{{*/
+    private:
+        RecordTypeObj *type;
+        EvalObj **slots;
+        /** Construct a record with unspecified slots in the storage
+         * allocated by `make` */
+        RecordObj(RecordTypeObj *type);
+    public:
+        /** Make a record of `type` */
+        static RecordObj *make(RecordTypeObj *type);
+        /** Release the storage of `make` */
+        static void operator delete(void *ptr);
+        ~RecordObj();
+        RecordTypeObj *get_type();
+        /** Get the slot at `idx` */
+        EvalObj *get(size_t idx);
+        /** Replace the slot at `idx` */
+        void set(size_t idx, EvalObj *obj);
+        ReprCons *get_repr_cons();
+
+        void gc_decrement();
+        void gc_trigger(EvalObj ** &tail);
+};/*}}}*/
+
+/** The procedures generated for a record type */
+enum RecordOptKind {
+    RECORD_CONSTRUCTOR,
+    RECORD_PREDICATE,
+    RECORD_ACCESSOR,
+    RECORD_MODIFIER
+};
+
+/** @class RecordOptObj
+ * A procedure on the records of a type, whose slots are resolved when the
+ * type is defined, so a call only checks the type of the record
+ */
+class RecordOptObj: public OptObj {/*{{{*/
+    private:
+        RecordOptKind kind;
+        RecordTypeObj *type;
+        string name;
+        /** The slot of an accessor or a modifier */
+        size_t slot;
+        /** The slots a constructor fills, in the order of its arguments */
+        std::vector<size_t> inits;
+        /** Get `obj` as a record of the type */
+        RecordObj *to_record(EvalObj *obj);
+    public:
+        /** Construct an accessor, a modifier or a predicate (which ignores
+         * `slot`) */
+        RecordOptObj(RecordOptKind kind, RecordTypeObj *type,
+                    const string &name, size_t slot = 0);
+        /** Construct a constructor */
+        RecordOptObj(RecordTypeObj *type, const string &name,
+                    const std::vector<size_t> &inits);
+        ~RecordOptObj();
+        RecordOptKind get_kind();
+        RecordTypeObj *get_type();
+        const string &get_name();
+        size_t get_slot();
+        const std::vector<size_t> &get_inits();
+        Pair *call(Pair *args, Environment * &envt,
+                    Continuation * &cont, EvalObj ** &top_ptr, Pair *pc);
+        ReprCons *get_repr_cons();
+};/*}}}*/
+
+#endif
@@ -0,0 +1,749 @@
+#include "serialize.h"
+#include "types.h"
+#include "port.h"
+#include "exc.h"
+#include "gc.h"
+#include "homovec.h"
+#include "hash.h"
+#include "record.h"
+
+#include <cstring>
+#include <vector>
+#include <map>
+#include <new>
+#include <unordered_map>
+
+extern EmptyList *empty_list;
+extern UnspecObj *unspec_obj;
+
+typedef std::unordered_map<EvalObj*, size_t> EvalObj2Index;
+typedef std::unordered_map<string, size_t> Str2Index;
+
+static void put_varint(OutputSink &out, unsigned long long val) {
+    char buff[10];
+    int len = 0;
+    do
+    {
+        unsigned char byte = val & 0x7f;
+        val >>= 7;
+        if (val) byte |= 0x80;
+        buff[len++] = byte;
+    } while (val);
+    out.write(buff, len);
+}
+
+static void put_double(OutputSink &out, double val) {
+    unsigned long long bits;
+    char buff[8];
+    memcpy(&bits, &val, sizeof(bits));
+    for (int i = 0; i < 8; i++, bits >>= 8)
+        buff[i] = bits & 0xff;
+    out.write(buff, 8);
+}
+
+static void put_bytes(OutputSink &out, const string &str) {
+    put_varint(out, str.length());
+    out.write(str);
+}
+
+#ifdef GMP_SUPPORT
+static void put_integer(OutputSink &out, const mpz_class &val) {
+    if (val.fits_slong_p())
+    {
+        long v = val.get_si();
+        out.put(SER_FIXNUM);
+        put_varint(out, (v < 0) ? ~((unsigned long long)v << 1) :
+                                    (unsigned long long)v << 1);
+        return;
+    }
+    size_t cnt = (mpz_sizeinbase(val.get_mpz_t(), 2) + 7) / 8;
+    string mag(cnt, '\0');
+    mpz_export(&mag[0], &cnt, -1, 1, 0, 0, val.get_mpz_t());
+    mag.resize(cnt);
+    out.put(SER_BIGNUM);
+    out.put(sgn(val) < 0);
+    put_bytes(out, mag);
+}
+#else
+static void put_integer(OutputSink &out, long v) {
+    out.put(SER_FIXNUM);
+    put_varint(out, (v < 0) ? ~((unsigned long long)v << 1) :
+                                (unsigned long long)v << 1);
+}
+#endif
+
+static void put_number(OutputSink &out, NumObj *num) {
+    switch (num->level)
+    {
+        case NUM_LVL_INT:
+            put_integer(out, static_cast<IntNumObj*>(num)->val);
+            break;
+        case NUM_LVL_RAT:
+            {
+                RatNumObj *rat = static_cast<RatNumObj*>(num);
+                out.put(SER_RAT);
+#ifdef GMP_SUPPORT
+                put_integer(out, rat->val.get_num());
+                put_integer(out, rat->val.get_den());
+#else
+                put_integer(out, rat->a);
+                put_integer(out, rat->b);
+#endif
+            }
+            break;
+        case NUM_LVL_REAL:
+            out.put(SER_REAL);
+            put_double(out, static_cast<RealNumObj*>(num)->real);
+            break;
+        default:
+            out.put(SER_COMP);
+            put_double(out, static_cast<CompNumObj*>(num)->real);
+            put_double(out, static_cast<CompNumObj*>(num)->imag);
+    }
+}
+
+/** Write `obj`, which may contain environments and procedures if it is
+ * written as an `image` */
+static void write_value(EvalObj *obj, OutputSink &out, bool image) {
+    EvalObj2Index shared;   // pairs, vectors, strings, etc. written so far
+    Str2Index syms;         // the symbol table
+    EvalObjVec todo(1, obj);
+    out.write(SERIAL_MAGIC, 3);
+    out.put(SERIAL_VERSION);
+    // pre-order traversal, so that the reader can create each object
+    // before its components (which may refer back to it)
+    while (!todo.empty())
+    {
+        obj = todo.back();
+        todo.pop_back();
+        int otype = obj->get_otype();
+        if (obj == empty_list)
+        {
+            out.put(SER_NIL);
+            continue;
+        }
+        if ((otype & (CLS_PAIR_OBJ | CLS_VECT_OBJ | CLS_STR_OBJ |
+                        CLS_HOMO_OBJ | CLS_RECORD_TYPE_OBJ |
+                        CLS_RECORD_OPT_OBJ)) ||
+                obj->is_container())
+        {
+            EvalObj2Index::iterator it = shared.find(obj);
+            if (it != shared.end())
+            {
+                out.put(SER_REF);
+                put_varint(out, it->second);
+                continue;
+            }
+            size_t idx = shared.size();
+            shared[obj] = idx;
+        }
+        if (obj->is_pair_obj())
+        {
+            out.put(SER_PAIR);
+            todo.push_back(TO_PAIR(obj)->cdr);
+            todo.push_back(TO_PAIR(obj)->car);
+        }
+        else if (obj->is_vect_obj())
+        {
+            EvalObjVec &vec = static_cast<VecObj*>(obj)->vec;
+            out.put(SER_VECT);
+            put_varint(out, vec.size());
+            todo.insert(todo.end(), vec.rbegin(), vec.rend());
+        }
+        else if (obj->is_str_obj())
+        {
+            out.put(SER_STR);
+            StrObj *str = static_cast<StrObj*>(obj);
+            put_varint(out, str->length());
+            out.write(str->data(), str->length());
+        }
+        else if (otype & CLS_HOMO_OBJ)
+        {
+            HomoVecObj *vec = static_cast<HomoVecObj*>(obj);
+            out.put(SER_HOMO);
+            out.put(vec->get_kind());
+            put_bytes(out, vec->data);
+        }
+        else if (otype & CLS_HASH_OBJ)
+        {
+            HashTableObj *table = static_cast<HashTableObj*>(obj);
+            EvalObjVec keys, vals;
+            table->get_entries(keys, vals);
+            out.put(SER_HASH);
+            out.put(table->get_kind());
+            put_varint(out, keys.size());
+            for (size_t i = keys.size(); i > 0; i--)
+            {
+                todo.push_back(vals[i - 1]);
+                todo.push_back(keys[i - 1]);
+            }
+        }
+        else if (obj->is_sym_obj())
+        {
+            const string &val = static_cast<SymObj*>(obj)->val;
+            Str2Index::iterator it = syms.find(val);
+            if (it != syms.end())
+            {
+                out.put(SER_SYM_REF);
+                put_varint(out, it->second);
+            }
+            else
+            {
+                size_t idx = syms.size();
+                syms[val] = idx;
+                out.put(SER_SYM);
+                put_bytes(out, val);
+            }
+        }
+        else if (obj->is_num_obj())
+            put_number(out, static_cast<NumObj*>(obj));
+        else if (obj->is_bool_obj())
+            out.put(obj->is_true() ? SER_TRUE : SER_FALSE);
+        else if (otype & CLS_CHAR_OBJ)
+        {
+            out.put(SER_CHAR);
+            out.put(static_cast<CharObj*>(obj)->ch);
+        }
+        else if (obj == unspec_obj)
+            out.put(SER_UNSPEC);
+        else if (obj == eof_obj)
+            out.put(SER_EOF);
+        else if (image && (otype & CLS_ENVT_OBJ))
+        {
+            Environment *envt = static_cast<Environment*>(obj);
+            const Str2EvalObj &binding = envt->get_bindings();
+            out.put(SER_ENVT);
+            put_varint(out, binding.size());
+            for (Str2EvalObj::const_iterator it = binding.begin();
+                    it != binding.end(); it++)
+                put_bytes(out, it->first);
+            for (Str2EvalObj::const_reverse_iterator it = binding.rbegin();
+                    it != binding.rend(); it++)
+                todo.push_back(it->second);
+            if (envt->get_prev())
+                todo.push_back(envt->get_prev());
+            else
+                todo.push_back(empty_list);
+        }
+        else if (image && (otype & CLS_RECORD_TYPE_OBJ))
+        {
+            RecordTypeObj *type = static_cast<RecordTypeObj*>(obj);
+            const std::vector<string> &fields = type->get_fields();
+            out.put(SER_RECORD_TYPE);
+            put_bytes(out, type->get_name());
+            put_varint(out, fields.size());
+            for (size_t i = 0; i < fields.size(); i++)
+                put_bytes(out, fields[i]);
+        }
+        else if (image && (otype & CLS_RECORD_OBJ))
+        {
+            // the type comes first, as it tells the number of slots
+            RecordObj *rec = static_cast<RecordObj*>(obj);
+            out.put(SER_RECORD);
+            for (size_t i = rec->get_type()->get_size(); i > 0; i--)
+                todo.push_back(rec->get(i - 1));
+            todo.push_back(rec->get_type());
+        }
+        else if (image && (otype & CLS_RECORD_OPT_OBJ))
+        {
+            RecordOptObj *opt = static_cast<RecordOptObj*>(obj);
+            const std::vector<size_t> &inits = opt->get_inits();
+            out.put(SER_RECORD_OPT);
+            out.put(opt->get_kind());
+            put_bytes(out, opt->get_name());
+            put_varint(out, opt->get_slot());
+            put_varint(out, inits.size());
+            for (size_t i = 0; i < inits.size(); i++)
+                put_varint(out, inits[i]);
+            todo.push_back(opt->get_type());
+        }
+        else if (image && obj->is_opt_obj() && obj->is_container())
+        {
+            ProcObj *proc = static_cast<ProcObj*>(obj);
+            out.put(SER_PROC);
+            todo.push_back(proc->envt);
+            todo.push_back(proc->body);
+            todo.push_back(proc->params);
+        }
+        else if (image && (otype & CLS_BUILTIN_OBJ))
+        {
+            out.put(SER_BUILTIN);
+            put_bytes(out, static_cast<BuiltinProcObj*>(obj)->get_name());
+        }
+        else if (image && (otype & CLS_SPECIAL_OBJ))
+        {
+            out.put(SER_SPECIAL);
+            put_bytes(out, static_cast<SpecialOptObj*>(obj)->get_name());
+        }
+        else
+            throw TokenError("a serializable object", RUN_ERR_WRONG_TYPE);
+    }
+}
+
+void serialize(EvalObj *obj, OutputSink &out) {
+    write_value(obj, out, false);
+}
+
+void serialize_image(Environment *top, OutputSink &out) {
+    write_value(top, out, true);
+}
+
+/** @class SerialReader
+ * Read the raw parts of the binary format from an input port
+ */
+class SerialReader {/*{{{*/
+    private:
+        InPortObj *port;
+    public:
+        SerialReader(InPortObj *_port) : port(_port) {}
+        /** @return false on the end of file */
+        bool more() {
+            return port->ptr != port->end || port->refill();
+        }
+        unsigned char get() {
+            if (!more()) throw NormalError(RUN_ERR_BAD_SERIAL);
+            return *port->ptr++;
+        }
+        unsigned long long get_varint() {
+            unsigned long long val = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                unsigned char byte = get();
+                val |= (unsigned long long)(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) return val;
+            }
+            throw NormalError(RUN_ERR_BAD_SERIAL);
+        }
+        /** Read the length of a part taking at least a byte per unit,
+         * which must fit in the rest of the input */
+        size_t get_length() {
+            unsigned long long len = get_varint();
+            if (len > port->get_remaining())
+                throw NormalError(RUN_ERR_BAD_SERIAL);
+            return len;
+        }
+        void get_bytes(string &res) {
+            size_t len = get_length();
+            res.clear();
+            while (len)
+            {
+                if (!more()) throw NormalError(RUN_ERR_BAD_SERIAL);
+                size_t cnt = port->end - port->ptr;
+                if (cnt > len) cnt = len;
+                res.append(port->ptr, cnt);
+                port->ptr += cnt;
+                len -= cnt;
+            }
+        }
+        double get_double() {
+            unsigned long long bits = 0;
+            double val;
+            for (int i = 0; i < 8; i++)
+                bits |= (unsigned long long)get() << (i * 8);
+            memcpy(&val, &bits, sizeof(val));
+            return val;
+        }
+#ifdef GMP_SUPPORT
+        /** Read the rest of an integer started by `tag` */
+        mpz_class get_integer(unsigned char tag) {
+            if (tag == SER_FIXNUM)
+            {
+                unsigned long long v = get_varint();
+                return mpz_class(long((v & 1) ? ~(v >> 1) : (v >> 1)));
+            }
+            if (tag != SER_BIGNUM) throw NormalError(RUN_ERR_BAD_SERIAL);
+            bool neg = get();
+            string mag;
+            get_bytes(mag);
+            mpz_class val;
+            mpz_import(val.get_mpz_t(), mag.length(), -1, 1, 0, 0, mag.data());
+            if (neg) val = -val;
+            return val;
+        }
+#else
+        /** Read the rest of an integer started by `tag` */
+        long get_integer(unsigned char tag) {
+            if (tag != SER_FIXNUM) throw NormalError(RUN_ERR_BAD_SERIAL);
+            unsigned long long v = get_varint();
+            return long((v & 1) ? ~(v >> 1) : (v >> 1));
+        }
+#endif
+};/*}}}*/
+
+/** A place waiting for a component: the car (0) or cdr (1) of a pair, an
+ * element of a vector, the outer environment (0) or a bound value of an
+ * environment, the parameters (0), body (1) or environment (2) of a
+ * procedure, the key (even) or value (odd) of an entry of a hash table,
+ * or a slot of a record */
+struct SerialSlot {
+    EvalObj *obj;
+    size_t idx;
+};
+
+typedef std::map<EvalObj*, std::vector<string> > EvalObj2Names;
+typedef std::unordered_map<EvalObj*, EvalObj*> EvalObj2Obj;
+
+/** An entry of a hash table read */
+struct HashFill {
+    HashTableObj *table;
+    EvalObj *key;
+    EvalObj *val;
+};
+
+/** The objects known while reading a value */
+struct SerialState {
+    EvalObjVec shared;      /**< Pairs, vectors, strings, etc. read so far */
+    EvalObjVec syms;        /**< The symbol table */
+    Environment *top;       /**< The environment an image is restored into,
+                              NULL if no image is being read */
+    Str2EvalObj builtins;   /**< Builtins and special operators by tag and
+                              name, which re-link the ones in an image */
+    EvalObj2Names names;    /**< The names bound by the environments read */
+    EvalObj2Index hash_sizes;   /**< The entry counts of the hash tables */
+    EvalObj2Obj hash_keys;  /**< The key of each hash table waiting for its
+                              value */
+    /** The entries of the hash tables, which are inserted after the whole
+     * value is read, when the keys are complete and can be hashed */
+    std::vector<HashFill> hash_fills;
+};
+
+static EvalObj *read_obj(SerialReader &rd, SerialState &st);
+
+/** Read the type of a record or a record procedure, which directly follows
+ * it, after reserving the place of the object in the shared ones
+ * @return the index of the place */
+static RecordTypeObj *read_record_type(SerialReader &rd, SerialState &st,
+                                        size_t &idx) {
+    idx = st.shared.size();
+    st.shared.push_back(NULL);
+    EvalObj *type = read_obj(rd, st);
+    if (!type || !(type->get_otype() & CLS_RECORD_TYPE_OBJ))
+        throw NormalError(RUN_ERR_BAD_SERIAL);
+    return static_cast<RecordTypeObj*>(type);
+}
+
+/** Read an object; containers are created empty */
+static EvalObj *read_obj(SerialReader &rd, SerialState &st) {
+    unsigned char tag = rd.get();
+    EvalObj *res;
+    string str;
+    size_t idx;
+    switch (tag)
+    {
+        case SER_NIL: return empty_list;
+        case SER_TRUE: return new BoolObj(true);
+        case SER_FALSE: return new BoolObj(false);
+        case SER_UNSPEC: return unspec_obj;
+        case SER_EOF: return eof_obj;
+        case SER_FIXNUM: case SER_BIGNUM:
+            return new IntNumObj(rd.get_integer(tag));
+        case SER_RAT:
+            {
+#ifdef GMP_SUPPORT
+                mpz_class a = rd.get_integer(rd.get());
+                mpz_class b = rd.get_integer(rd.get());
+                if (b == 0) throw NormalError(RUN_ERR_BAD_SERIAL);
+                mpq_class val(a, b);
+                val.canonicalize();
+                return new RatNumObj(val);
+#else
+                long a = rd.get_integer(rd.get());
+                long b = rd.get_integer(rd.get());
+                if (!b) throw NormalError(RUN_ERR_BAD_SERIAL);
+                return new RatNumObj(a, b);
+#endif
+            }
+        case SER_REAL: return new RealNumObj(rd.get_double());
+        case SER_COMP:
+            {
+                double real = rd.get_double();
+                return new CompNumObj(real, rd.get_double());
+            }
+        case SER_CHAR: return new CharObj(rd.get());
+        case SER_STR:
+            rd.get_bytes(str);
+            st.shared.push_back(res = new StrObj(str));
+            return res;
+        case SER_HOMO:
+            {
+                unsigned char kind = rd.get();
+                if (kind >= HOMO_KIND_NUM)
+                    throw NormalError(RUN_ERR_BAD_SERIAL);
+                rd.get_bytes(str);
+                if (str.length() % HOMO_ELEM_SIZE[kind])
+                    throw NormalError(RUN_ERR_BAD_SERIAL);
+                st.shared.push_back(res = new HomoVecObj(HomoKind(kind),
+                                                        std::move(str)));
+                return res;
+            }
+        case SER_HASH:
+            {
+                unsigned char kind = rd.get();
+                if (kind > HASH_WEAK)
+                    throw NormalError(RUN_ERR_BAD_SERIAL);
+                idx = rd.get_length();
+                st.shared.push_back(res = new HashTableObj(HashKind(kind)));
+                st.hash_sizes[res] = idx;
+                return res;
+            }
+        case SER_SYM:
+            rd.get_bytes(str);
+            st.syms.push_back(res = new SymObj(str));
+            return res;
+        case SER_SYM_REF:
+            if ((idx = rd.get_varint()) >= st.syms.size())
+                throw NormalError(RUN_ERR_BAD_SERIAL);
+            return st.syms[idx];
+        case SER_PAIR:
+            st.shared.push_back(res = new Pair(empty_list, empty_list));
+            return res;
+        case SER_VECT:
+            idx = rd.get_length();
+            // the length is not checked on a stream
+            try
+            {
+                res = new VecObj(idx, unspec_obj);
+            }
+            catch (std::bad_alloc &e)
+            {
+                throw NormalError(RUN_ERR_BAD_SERIAL);
+            }
+            st.shared.push_back(res);
+            return res;
+        case SER_REF:
+            if ((idx = rd.get_varint()) >= st.shared.size())
+                throw NormalError(RUN_ERR_BAD_SERIAL);
+            return st.shared[idx];
+        case SER_ENVT:
+            {
+                if (!st.top) break;
+                std::vector<string> names(rd.get_length());
+                for (size_t i = 0; i < names.size(); i++)
+                    rd.get_bytes(names[i]);
+                // the root of an image is restored into the top level
+                res = st.shared.empty() ? st.top : new Environment(NULL);
+                st.shared.push_back(res);
+                st.names[res].swap(names);
+                return res;
+            }
+        case SER_PROC:
+            if (!st.top) break;
+            st.shared.push_back(res = new ProcObj(NULL, NULL, NULL));
+            return res;
+        case SER_RECORD_TYPE:
+            {
+                if (!st.top) break;
+                rd.get_bytes(str);
+                std::vector<string> fields(rd.get_length());
+                for (size_t i = 0; i < fields.size(); i++)
+                    rd.get_bytes(fields[i]);
+                st.shared.push_back(res = new RecordTypeObj(str, fields));
+                return res;
+            }
+        case SER_RECORD:
+            {
+                if (!st.top) break;
+                RecordTypeObj *type = read_record_type(rd, st, idx);
+                return st.shared[idx] = RecordObj::make(type);
+            }
+        case SER_RECORD_OPT:
+            {
+                if (!st.top) break;
+                unsigned char kind = rd.get();
+                if (kind > RECORD_MODIFIER)
+                    throw NormalError(RUN_ERR_BAD_SERIAL);
+                rd.get_bytes(str);
+                size_t slot = rd.get_varint();
+                std::vector<size_t> inits(rd.get_length());
+                for (size_t i = 0; i < inits.size(); i++)
+                    inits[i] = rd.get_varint();
+                RecordTypeObj *type = read_record_type(rd, st, idx);
+                // the slots must be those of the type
+                size_t size = type->get_size();
+                if (kind != RECORD_PREDICATE && slot >= size)
+                    throw NormalError(RUN_ERR_BAD_SERIAL);
+                for (size_t i = 0; i < inits.size(); i++)
+                    if (inits[i] >= size)
+                        throw NormalError(RUN_ERR_BAD_SERIAL);
+                if (kind == RECORD_CONSTRUCTOR)
+                    res = new RecordOptObj(type, str, inits);
+                else
+                    res = new RecordOptObj(RecordOptKind(kind), type, str,
+                                            slot);
+                return st.shared[idx] = res;
+            }
+        case SER_BUILTIN: case SER_SPECIAL:
+            {
+                if (!st.top) break;
+                rd.get_bytes(str);
+                Str2EvalObj::iterator it =
+                    st.builtins.find(string(1, tag) + str);
+                if (it == st.builtins.end())
+                    throw TokenError(str, RUN_ERR_UNBOUND_VAR);
+                return it->second;
+            }
+    }
+    throw NormalError(RUN_ERR_BAD_SERIAL);
+}
+
+/** Get the number of components of a container just read */
+static size_t get_component_num(SerialState &st, EvalObj *obj) {
+    if (obj->is_pair_obj()) return 2;
+    if (obj->is_vect_obj()) return static_cast<VecObj*>(obj)->get_size();
+    if (obj->get_otype() & CLS_ENVT_OBJ) return st.names[obj].size() + 1;
+    if (obj->get_otype() & CLS_HASH_OBJ) return st.hash_sizes[obj] * 2;
+    if (obj->get_otype() & CLS_RECORD_OBJ)
+        return static_cast<RecordObj*>(obj)->get_type()->get_size();
+    if (obj->get_otype() & CLS_RECORD_OPT_OBJ) return 0;
+    if (obj->is_opt_obj()) return 3;
+    return 0;
+}
+
+/** Replace a field of a container by `obj` */
+static void set_field(EvalObj *&field, EvalObj *obj) {
+    gc.expose(field);
+    field = gc.attach(obj);
+}
+
+/** Put `obj` into the place of `slot` */
+static void fill_slot(SerialState &st, const SerialSlot &slot, EvalObj *obj) {
+    if (slot.obj->is_pair_obj())
+    {
+        Pair *p = TO_PAIR(slot.obj);
+        set_field(slot.idx ? p->cdr : p->car, obj);
+    }
+    else if (slot.obj->is_vect_obj())
+        static_cast<VecObj*>(slot.obj)->set(slot.idx, obj);
+    else if (slot.obj->get_otype() & CLS_RECORD_OBJ)
+        static_cast<RecordObj*>(slot.obj)->set(slot.idx, obj);
+    else if (slot.obj->get_otype() & CLS_HASH_OBJ)
+    {
+        HashTableObj *table = static_cast<HashTableObj*>(slot.obj);
+        if (slot.idx & 1)
+        {
+            HashFill fill = {table, st.hash_keys[table], obj};
+            st.hash_fills.push_back(fill);
+        }
+        else if (table->get_kind() == HASH_STRING && !obj->is_str_obj())
+            throw NormalError(RUN_ERR_BAD_SERIAL);
+        else
+            st.hash_keys[table] = obj;
+    }
+    else if (slot.obj->get_otype() & CLS_ENVT_OBJ)
+    {
+        Environment *envt = static_cast<Environment*>(slot.obj);
+        if (slot.idx)
+        {
+            SymObj *sym = new SymObj(st.names[envt][slot.idx - 1]);
+            envt->add_binding(sym, obj);
+            delete sym;
+        }
+        else if (obj == empty_list)
+            envt->set_prev(NULL);
+        else if (obj->get_otype() & CLS_ENVT_OBJ)
+            envt->set_prev(static_cast<Environment*>(obj));
+        else
+            throw NormalError(RUN_ERR_BAD_SERIAL);
+    }
+    else
+    {
+        ProcObj *proc = static_cast<ProcObj*>(slot.obj);
+        if (slot.idx == 0)
+            set_field(proc->params, obj);
+        else if (slot.idx == 1 && obj->is_pair_obj() && obj != empty_list)
+        {
+            gc.expose(proc->body);
+            proc->body = TO_PAIR(gc.attach(obj));
+        }
+        else if (slot.idx == 2 && (obj->get_otype() & CLS_ENVT_OBJ))
+        {
+            gc.expose(proc->envt);
+            proc->envt = static_cast<Environment*>(gc.attach(obj));
+        }
+        else
+            throw NormalError(RUN_ERR_BAD_SERIAL);
+    }
+}
+
+/** Read a value, whose magic number has been checked, from `rd` */
+static EvalObj *read_value(SerialReader &rd, SerialState &st) {
+    std::vector<SerialSlot> slots;
+    EvalObj *root = NULL;
+    try
+    {
+        do
+        {
+            size_t nshared = st.shared.size();
+            EvalObj *obj = read_obj(rd, st);
+            if (!root)
+                gc.attach(root = obj);  // keep the partial result
+            else
+            {
+                fill_slot(st, slots.back(), obj);
+                slots.pop_back();
+            }
+            // a new container, whose components follow
+            if (st.shared.size() > nshared)
+                for (size_t i = get_component_num(st, obj); i > 0; i--)
+                    slots.push_back((SerialSlot){obj, i - 1});
+        } while (!slots.empty());
+        for (size_t i = 0; i < st.hash_fills.size(); i++)
+        {
+            HashFill &fill = st.hash_fills[i];
+            fill.table->set(fill.key, fill.val);
+        }
+    }
+    catch (GeneralError &e)
+    {
+        gc.expose(root);
+        throw;
+    }
+    // handed to the caller, which attaches it
+    gc.expose(root);
+    return root;
+}
+
+/** Check the magic number of a value
+ * @return false on the end of file */
+static bool read_magic(SerialReader &rd) {
+    if (!rd.more()) return false;
+    char magic[4];
+    for (int i = 0; i < 4; i++)
+        magic[i] = rd.get();
+    if (memcmp(magic, SERIAL_MAGIC, 3) || magic[3] != SERIAL_VERSION)
+        throw NormalError(RUN_ERR_BAD_SERIAL);
+    return true;
+}
+
+EvalObj *deserialize(InPortObj *port) {
+    SerialReader rd(port);
+    if (!read_magic(rd)) return NULL;
+    SerialState st;
+    st.top = NULL;
+    return read_value(rd, st);
+}
+
+void deserialize_image(Environment *top, InPortObj *port) {
+    SerialReader rd(port);
+    if (!read_magic(rd)) throw NormalError(RUN_ERR_BAD_SERIAL);
+    SerialState st;
+    st.top = top;
+    const Str2EvalObj &binding = top->get_bindings();
+    for (Str2EvalObj::const_iterator it = binding.begin();
+            it != binding.end(); it++)
+    {
+        int otype = it->second->get_otype();
+        if (otype & CLS_BUILTIN_OBJ)
+            st.builtins[string(1, SER_BUILTIN) +
+                static_cast<BuiltinProcObj*>(it->second)->get_name()] =
+                it->second;
+        else if (otype & CLS_SPECIAL_OBJ)
+            st.builtins[string(1, SER_SPECIAL) +
+                static_cast<SpecialOptObj*>(it->second)->get_name()] =
+                it->second;
+    }
+    // an image is never empty, as its root is the top level
+    if (!rd.more() || (unsigned char)*port->ptr != SER_ENVT)
+        throw NormalError(RUN_ERR_BAD_SERIAL);
+    read_value(rd, st);
+}
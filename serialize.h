@@ -0,0 +1,86 @@
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include "model.h"
+
+class InPortObj;
+class Environment;
+
+/** The magic number at the beginning of every serialized value */
+const char SERIAL_MAGIC[] = "SNB";
+/** The version of the binary format */
+const unsigned char SERIAL_VERSION = 1;
+
+/** The tags of the binary format. Every object starts with a tag byte,
+ * followed by its payload:
+ *  - integers: a zigzag varint (FIXNUM), or a sign byte, a varint byte
+ *    count and the little-endian magnitude (BIGNUM)
+ *  - rationals: the numerator and denominator as integers
+ *  - inexact numbers: the little-endian IEEE 754 bits of each part
+ *  - strings and new symbols: a varint length and the bytes
+ *  - symbols seen before: a varint index into the symbol table
+ *  - pairs: the car, then the cdr; vectors: a varint size and elements
+ *  - homogeneous vectors: the kind byte, then the elements as bytes in
+ *    native byte order
+ *  - hash tables: the kind byte (which tells weak tables), a varint count
+ *    of entries, then the key and the value of each entry
+ *  - REF: a varint index of a pair, vector, string or hash table written
+ *    before, which preserves shared and circular structures
+ * Heap images may also contain:
+ *  - environments: a varint count and the bound names, then the outer
+ *    environment (NIL for none) and the bound values
+ *  - procedures: the parameters, the body and the environment
+ *  - builtins and special operators: the name, re-linked on loading
+ *  - record types: the name, a varint count and the field names
+ *  - records: the type, then the slots
+ *  - record procedures: the kind byte, the name, the varint slot of an
+ *    accessor or modifier, a varint count and the slots a constructor
+ *    fills, then the type
+ * which are shared by REF as well.
+ */
+enum SerialTag {
+    SER_NIL,
+    SER_TRUE,
+    SER_FALSE,
+    SER_UNSPEC,
+    SER_EOF,
+    SER_FIXNUM,
+    SER_BIGNUM,
+    SER_RAT,
+    SER_REAL,
+    SER_COMP,
+    SER_CHAR,
+    SER_STR,
+    SER_SYM,
+    SER_SYM_REF,
+    SER_PAIR,
+    SER_VECT,
+    SER_REF,
+    SER_ENVT,
+    SER_PROC,
+    SER_BUILTIN,
+    SER_SPECIAL,
+    SER_HOMO,
+    SER_HASH,
+    SER_RECORD_TYPE,
+    SER_RECORD,
+    SER_RECORD_OPT
+};
+
+/** Write `obj` in the binary format to `out` */
+void serialize(EvalObj *obj, OutputSink &out);
+
+/** Read a value in the binary format from `port`
+ * @return NULL on the end of file
+ */
+EvalObj *deserialize(InPortObj *port);
+
+/** Write the heap image of the top-level environment `top`, including
+ * everything reachable from its bindings, to `out` */
+void serialize_image(Environment *top, OutputSink &out);
+
+/** Restore the heap image from `port` into the top-level environment `top`,
+ * whose builtins replace the ones of the same names in the image */
+void deserialize_image(Environment *top, InPortObj *port);
+
+#endif
@@ -0,0 +1,144 @@
+#include "strsearch.h"
+
+#include <cstring>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+/** The search kernels of an instruction set */
+struct StrKernels {
+    size_t (*find_char)(const char *str, size_t len, char ch);
+    size_t (*find)(const char *str, size_t len, const char *pat, size_t plen);
+};
+
+/** Check the candidates in `mask`, whose bit k stands for the position
+ * `st + k` where the first and the last byte of the pattern match */
+static inline size_t check_mask(unsigned mask, const char *str, size_t st,
+                                const char *pat, size_t plen) {
+    for (; mask; mask &= mask - 1)
+    {
+        size_t pos = st + __builtin_ctz(mask);
+        if (!memcmp(str + pos + 1, pat + 1, plen - 2))
+            return pos;
+    }
+    return STR_NPOS;
+}
+
+/** Search the positions from `st` on one by one */
+static size_t scalar_find_from(const char *str, size_t len, size_t st,
+                                const char *pat, size_t plen) {
+    for (size_t i = st; i + plen <= len; i++)
+        if (str[i] == pat[0] && !memcmp(str + i + 1, pat + 1, plen - 1))
+            return i;
+    return STR_NPOS;
+}
+
+#ifdef __x86_64__
+/* SSE2 is part of x86-64, AVX2 is only used if the CPU supports it */
+
+static size_t sse2_find_char(const char *str, size_t len, char ch) {
+    __m128i pat = _mm_set1_epi8(ch);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i blk = _mm_loadu_si128((const __m128i *)(str + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(blk, pat));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    for (; i < len; i++)
+        if (str[i] == ch) return i;
+    return STR_NPOS;
+}
+
+static size_t sse2_find(const char *str, size_t len,
+                        const char *pat, size_t plen) {
+    if (plen > len) return STR_NPOS;
+    if (plen == 0) return 0;
+    if (plen == 1) return sse2_find_char(str, len, pat[0]);
+    __m128i first = _mm_set1_epi8(pat[0]);
+    __m128i last = _mm_set1_epi8(pat[plen - 1]);
+    size_t i = 0;
+    for (; i + plen - 1 + 16 <= len; i += 16)
+    {
+        __m128i bf = _mm_loadu_si128((const __m128i *)(str + i));
+        __m128i bl = _mm_loadu_si128((const __m128i *)(str + i + plen - 1));
+        unsigned mask = _mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(bf, first),
+                                _mm_cmpeq_epi8(bl, last)));
+        size_t pos = check_mask(mask, str, i, pat, plen);
+        if (pos != STR_NPOS) return pos;
+    }
+    return scalar_find_from(str, len, i, pat, plen);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static size_t avx2_find_char(const char *str, size_t len, char ch) {
+    __m256i pat = _mm256_set1_epi8(ch);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i blk = _mm256_loadu_si256((const __m256i *)(str + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(blk, pat));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    size_t res = sse2_find_char(str + i, len - i, ch);
+    return res == STR_NPOS ? res : i + res;
+}
+
+AVX2 static size_t avx2_find(const char *str, size_t len,
+                            const char *pat, size_t plen) {
+    if (plen > len) return STR_NPOS;
+    if (plen == 0) return 0;
+    if (plen == 1) return avx2_find_char(str, len, pat[0]);
+    __m256i first = _mm256_set1_epi8(pat[0]);
+    __m256i last = _mm256_set1_epi8(pat[plen - 1]);
+    size_t i = 0;
+    for (; i + plen - 1 + 32 <= len; i += 32)
+    {
+        __m256i bf = _mm256_loadu_si256((const __m256i *)(str + i));
+        __m256i bl = _mm256_loadu_si256(
+                        (const __m256i *)(str + i + plen - 1));
+        unsigned mask = _mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(bf, first),
+                                _mm256_cmpeq_epi8(bl, last)));
+        size_t pos = check_mask(mask, str, i, pat, plen);
+        if (pos != STR_NPOS) return pos;
+    }
+    return scalar_find_from(str, len, i, pat, plen);
+}
+
+static const StrKernels sse2_kernels = {sse2_find_char, sse2_find};
+static const StrKernels avx2_kernels = {avx2_find_char, avx2_find};
+
+/** Pick the kernels once, on the first search */
+static const StrKernels &str_kernels() {
+    static const StrKernels &kernels =
+        __builtin_cpu_supports("avx2") ? avx2_kernels : sse2_kernels;
+    return kernels;
+}
+#else
+static size_t scalar_find_char(const char *str, size_t len, char ch) {
+    const char *res = static_cast<const char *>(memchr(str, ch, len));
+    return res ? res - str : STR_NPOS;
+}
+
+static size_t scalar_find(const char *str, size_t len,
+                        const char *pat, size_t plen) {
+    if (plen > len) return STR_NPOS;
+    if (plen == 0) return 0;
+    return scalar_find_from(str, len, 0, pat, plen);
+}
+
+static const StrKernels scalar_kernels = {scalar_find_char, scalar_find};
+static const StrKernels &str_kernels() { return scalar_kernels; }
+#endif
+
+size_t str_find_char(const char *str, size_t len, char ch) {
+    return str_kernels().find_char(str, len, ch);
+}
+
+size_t str_find(const char *str, size_t len, const char *pat, size_t plen) {
+    return str_kernels().find(str, len, pat, plen);
+}
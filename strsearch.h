@@ -0,0 +1,20 @@
+#ifndef STRSEARCH_H
+#define STRSEARCH_H
+
+#include <cstddef>
+
+/** The result of a failed search */
+const size_t STR_NPOS = (size_t)-1;
+
+/** Find the first `ch` in the `len` bytes at `str`
+ * @return the offset, or STR_NPOS if not found */
+size_t str_find_char(const char *str, size_t len, char ch);
+
+/** Find the first occurrence of the `plen` bytes at `pat` in the `len`
+ * bytes at `str`. The blocks of `str` are scanned with SSE2 or AVX2
+ * (depending on the CPU) for the positions where both the first and the
+ * last byte of the pattern match, and only those are compared in full.
+ * @return the offset, or STR_NPOS if not found */
+size_t str_find(const char *str, size_t len, const char *pat, size_t plen);
+
+#endif
@@ -0,0 +1,47 @@
+(display "Test closures: \n")
+(display (counter))
+(display (counter))
+(display (fact 20))
+(display (add 1 2))
+(display "\n")
+
+(display "Test strings and vectors: \n")
+(display greeting)
+(write chars)
+(display v)
+(display (eq? (car shared) (car (cdr shared))))
+(display (eq? (car shared) v))
+(display (car (cdr (cdr (cdr cycle)))))
+(display (eq? (cdr (cdr (cdr cycle))) cycle))
+(display big)
+(display "\n")
+
+(display "Test hash tables: \n")
+(display (hash-table-ref t '(1 2)))
+(display (hash-table-ref t "s"))
+(display (eq? (hash-table-ref t 'self) t))
+(display (hash-table-count t))
+(display (hash-table-ref ts "abc"))
+(display (hash-table-ref/default ts "ab" 'none))
+(display (hash-table-ref te 3))
+(display (hash-table-ref tw weak-key))
+(display (eq? (car tables) t))
+(display (eq? (car (cdr tables)) ts))
+(display "\n")
+
+(display "Test records: \n")
+(display (point-x p))
+(display (point-y p))
+(display (point? p))
+(display (point? ring))
+(display (node? ring))
+(display (eq? (node-next ring) ring))
+(display (eq? get-x point-x))
+(display (point-x (vector-ref points 1)))
+(set-point-x! p 10)
+(display (get-x p))
+(display (point-x (make-point 5 6)))
+(display p)
+(display point)
+(display "\n")
+(point-x ring)
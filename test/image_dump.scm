@@ -0,0 +1,43 @@
+; Heap image round trip, checked by image_check.scm:
+;   sonsi -l test/image_dump.scm --dump-image /tmp/test.img /dev/null
+;   sonsi --image /tmp/test.img test/image_check.scm > test/image_test.log 2>&1
+; `make check` runs both.
+
+(define (make-counter)
+  (define n 0)
+  (lambda () (set! n (+ n 1)) n))
+(define counter (make-counter))
+(counter)
+(define (fact n) (if (= n 0) 1 (* n (fact (- n 1)))))
+(define add +)
+(define greeting "hello")
+(define chars (list #\a #\space))
+(define v '#(1 "two" three 4.5 (5 6)))
+(define shared (list v v))
+(define cycle (list 1 2 3))
+(set-cdr! (cdr (cdr cycle)) cycle)
+(define big 123456789012345678901234567890)
+
+(define t (make-hash-table))
+(hash-table-set! t '(1 2) 'list-key)
+(hash-table-set! t "s" 42)
+(hash-table-set! t 'self t)
+(define ts (make-hash-table string=?))
+(hash-table-set! ts "abc" 1)
+(define te (make-hash-table eqv?))
+(hash-table-set! te 3 'three)
+(define weak-key (list 'kept))
+(define tw (make-weak-hash-table))
+(hash-table-set! tw weak-key 'weak-val)
+(hash-table-set! tw (list 'dropped) 'gone)
+(define tables (list t ts))
+
+(define-record-type point (make-point x y) point?
+  (x point-x set-point-x!)
+  (y point-y))
+(define p (make-point 1 2))
+(define-record-type node node node? (val node-val) (next node-next set-node-next!))
+(define ring (node 'a '()))
+(set-node-next! ring ring)
+(define get-x point-x)
+(define points (vector p (make-point 3 4)))
@@ -401,3 +401,504 @@ x
 (force prom2)
 (force prom2)
 
+
+(display "Test merge: \n")
+(define (lt a b) (< a b))
+(display (merge '(5) '(1 2 3) lt))
+(display (merge '(1 4 9) '(2 3 5 6 7 8 10) lt))
+(display (merge '(1 4 9 11 12 13) '(2 3) lt))
+(display (merge '(1 4 9) '(2 3 5 6 7 8 10) <))
+(define v #(3 1 2 9 8 7 5 4 6 0 11))
+(vector-sort! lt v)
+(display v)
+(display "\n")
+
+(display "Test flonum output: \n")
+(display 4.0)
+(display " ")
+(display -0.0)
+(display " ")
+(display 1e21)
+(display " ")
+(display (exact? (string->number (number->string 4.0))))
+(display " ")
+(display (= (string->number (number->string 1e21)) 1e21))
+(display "\n")
+
+(display "Test flonum and fixnum arithmetic: \n")
+(display (fl+ 1.5 2.25))
+(display " ")
+(display (fl* 2.0 0.5))
+(display " ")
+(display (fl< 1.0 2.0 3.0))
+(display " ")
+(display (flsqrt 16.0))
+(display " ")
+(display (fx* 6 7))
+(display " ")
+(display (fxquotient 17 5))
+(display " ")
+(display (flonum? 1.0))
+(display (fixnum? 1.0))
+(display (fixnum? 12345678901234567890))
+(display "\n")
+(fl+ 1 2.0)
+(fx+ 9223372036854775807 1)
+
+(display "Test literal classification: \n")
+(display (exact? +5))
+(display (exact? -7))
+(display (symbol? 'inf))
+(display (symbol? '0x10))
+(display (symbol? '+))
+(display (symbol? '...))
+(display " ")
+(display 1/2)
+(display " ")
+(display -3/6)
+(display " ")
+(display 1.5e2)
+(display " ")
+(display .5)
+(display " ")
+(display 12345678901234567890123)
+(display " ")
+(display (+ 999999999999999999 1))
+(display "\n")
+
+(display "Test reader scanning: \n")
+(display '(a(b)c))
+(write '(1"x(y)"#\a))
+(write (quote #(1 "x(y)" #\space)))
+(write "tab\tquote\"backslash\\")
+(display (string-length "a\nb"))
+(display "\n")
+
+(display "Test token views: \n")
+(display 'HeLLo)
+(display (eq? 'ABC 'abc))
+(display ''a)
+(display '#(1 (2 #(3)) "four" #t))
+(display (vector-length '#()))
+(display "\n")
+
+(display "Test external representations: \n")
+(write '(1 "a\"b" #\b #\space 2.5 sym))
+(display '(1 "a\"b" #\b))
+(define c (list 1 2))
+(set-car! c c)
+(display c)
+(set-car! c 1)
+(set-cdr! (cdr c) c)
+(display c)
+(display '(1 . 2))
+(display '(1 (2 . 3) #(4 (5))))
+(display "\n")
+
+(display "Test output ports: \n")
+(define out (current-output-port))
+(set-port-buffering! out 'none)
+(write-string "none" out)
+(write-char #\space out)
+(set-port-buffering! out 'line)
+(write "line" out)
+(newline out)
+(set-port-buffering! out 'full)
+(display 'full out)
+(flush-output-port out)
+(newline)
+(set-port-buffering! out 'often)
+(write-char "a")
+
+(display "Test read: \n")
+(define (write-data p)
+  (display "(1 \"two\" #(3)) sym 4.5\nnext line\n" p)
+  (close-output-port p))
+(write-data (open-output-file "/tmp/sonsi_robust_read.txt"))
+(define (read-data p)
+  (define a (read p))
+  (define b (read p))
+  (define c (read p))
+  (define d (read-line p))
+  (define e (read-line p))
+  (define f (read p))
+  (close-input-port p)
+  (list a b c d e (eof-object? f)))
+(write (read-data (open-input-file "/tmp/sonsi_robust_read.txt")))
+(display "\n")
+
+(display "Test equal-hash on a shared head: \n")
+(define (pad n tail) (if (= n 0) tail (pad (- n 1) (cons 0 tail))))
+(define (key i) (pad 100 (list i)))
+(display (= (equal-hash (key 1)) (equal-hash (key 2))))
+(display (= (equal-hash (key 1)) (equal-hash (key 1))))
+(display (= (equal-hash (pad 100 '())) (equal-hash (pad 101 '()))))
+(define (vkey i) (list->vector (key i)))
+(display (= (equal-hash (vkey 1)) (equal-hash (vkey 2))))
+(define keys (make-hash-table equal?))
+(define (fill i n)
+  (if (< i n) (and (hash-table-set! keys (key i) i) (fill (+ i 1) n))))
+(fill 0 2000)
+(display (hash-table-count keys))
+(display (hash-table-ref keys (key 1999)))
+(define c (list 1 2 3))
+(set-cdr! (cdr (cdr c)) c)
+(display (= (equal-hash c) (equal-hash c)))
+(display "\n")
+
+(display "Test equal? on shared and circular structures: \n")
+(define long1 (vector->list (make-vector 1000000 'x)))
+(define long2 (vector->list (make-vector 1000000 'x)))
+(display (equal? long1 long2))
+(define v3 (make-vector 1000000 'x))
+(vector-set! v3 999999 'y)
+(define long3 (vector->list v3))
+(display (equal? long1 long3))
+(define c1 (list 1 2))
+(set-cdr! (cdr c1) c1)
+(define c2 (list 1 2 1 2))
+(set-cdr! (cdr (cdr (cdr c2))) c2)
+(display (equal? c1 c2))
+(define c3 (list 1 3))
+(set-cdr! (cdr c3) c3)
+(display (equal? c1 c3))
+(define v1 (make-vector 2 0))
+(vector-set! v1 1 v1)
+(define v2 (make-vector 2 0))
+(vector-set! v2 1 v2)
+(display (equal? v1 v2))
+(vector-set! v2 0 1)
+(display (equal? v1 v2))
+(define s (list "a" #(1 2)))
+(display (equal? (list s s s) (list s (list "a" #(1 2)) s)))
+(display (equal? (list s s) (list s (list "a" #(1 3)))))
+(display "\n")
+
+(display "Test homogeneous vectors: \n")
+(define v '#f64(1 2.5 -3))
+(display v)
+(display (f64vector? v))
+(display (f64vector-length v))
+(display (f64vector-ref v 1))
+(display '#u8(0 255))
+(display '#s16(-32768 32767))
+(display '#f32(0.5))
+(display (u8vector->list '#u8(1 2 3)))
+(display "\n")
+(define a (f64vector 1 2 3 4 5 6 7 8 9))
+(define b (f64vector 9 8 7 6 5 4 3 2 1))
+(display (f64vector-add a b))
+(display (f64vector-mul a b))
+(display (f64vector-scale a 0.5))
+(display (f64vector-dot a b))
+(display " ")
+(display (f64vector-sum a))
+(display " ")
+(display (f64vector-min b))
+(display (f64vector-max b))
+(display (f32vector-sum (f32vector 1 2 3)))
+(display "\n")
+; NaN makes min and max NaN wherever it is, on the SIMD blocks and the tail
+(display (f64vector-min (f64vector +nan.0 1 2)))
+(display (f64vector-min (f64vector 1 +nan.0 2)))
+(display (f64vector-min (f64vector 1 2 +nan.0)))
+(display (f64vector-max (f64vector 1 2 3 4 5 6 7 8 +nan.0)))
+(display (f64vector-max (f64vector 1 2 3 +nan.0 5 6 7 8 9)))
+(display (f32vector-min (f32vector 1 +nan.0 2)))
+(display "\n")
+(u8vector 256)
+(s8vector -129)
+(u16vector -1)
+(f64vector 'a)
+(f64vector-add a (f64vector 1))
+; bytevector binary accessors in both byte orders
+(define bv (bytevector 1 2 3 4 5 6 7 8))
+(display (bytevector-u16-ref bv 0 'little))
+(display " ")
+(display (bytevector-u16-ref bv 0 'big))
+(display " ")
+(display (bytevector-u32-ref bv 4 'big))
+(display " ")
+(display (bytevector-s8-ref (bytevector 255) 0))
+(display " ")
+(display (bytevector-u64-ref bv 0 'little))
+(display "\n")
+(bytevector-s16-set! bv 0 -2 'big)
+(display bv)
+(bytevector-u32-set! bv 4 1 'little)
+(display bv)
+(bytevector-ieee-double-set! bv 0 1.5 'big)
+(display bv)
+(display (bytevector-ieee-double-ref bv 0 'big))
+(display " ")
+(bytevector-ieee-single-native-set! bv 0 -0.25)
+(display (bytevector-ieee-single-native-ref bv 0))
+(display "\n")
+(bytevector-u16-ref bv 7 'big)
+(bytevector-u16-ref bv 0 'middle)
+(bytevector-u16-native-ref bv 0 'big)
+; copying within a bytevector, to either side of the source
+(define bv (bytevector 1 2 3 4 5 6 7 8))
+(bytevector-copy! bv 2 bv 0 5)
+(display bv)
+(bytevector-copy! bv 0 bv 3)
+(display bv)
+(bytevector-copy! bv 7 bv 0 2)
+; the conversions copy, so changing one side leaves the other alone
+(define u (string->utf8 "hello"))
+(define s (utf8->string u 1 4))
+(bytevector-u8-set! u 1 65)
+(display s)
+(display (utf8->string u))
+(display "\n")
+; the list library: results, unequal lengths, empty and improper lists
+(define (odd? x) (= (remainder x 2) 1))
+(display (map + '(1 2 3) '(10 20 30 40)))
+(display (map (lambda (x) (* x x)) '()))
+(display (map car '((a 1) (b 2))))
+(for-each (lambda (x y) (display (+ x y))) '(1 2 3) '(10 20))
+(display (for-each display '()))
+(display "\n")
+(display (fold cons '() '(1 2 3)))
+(display (fold + 0 '(1 2 3) '(10 20)))
+(display (fold-left list '() '(1 2 3)))
+(display (fold-left + 0 '(1 2) '(10 20 30)))
+(display (fold-right cons '() '(1 2 3)))
+(display (fold-right list 'z '(1 2 3) '(a b)))
+(display (fold + 5 '()))
+(display (fold-right + 5 '()))
+(display "\n")
+(display (filter odd? '(1 2 3 4 5)))
+(display (remove odd? '(1 2 3 4 5)))
+(display (filter odd? '()))
+(display (filter odd? '(2 4)))
+(display (remove odd? '(1)))
+(display "\n")
+(map car '((a) . b))
+(map + '(1 2 . 3) '(1 2 3))
+(for-each display '(1 . 2))
+(fold + 0 '(1 2 . 3))
+(filter odd? '(1 2 . 3))
+(map 1 '(1 2))
+(fold +)
+(display "\n")
+(display (memq 'c '(a b c d)))
+(display (memq 'z '(a b c)))
+(display (memv 101 '(100 101 102)))
+(display (member "b" '("a" "b" "c")))
+(display (member '(1) '((0) (1) (2))))
+(display (memq 'a '()))
+(display "\n")
+(display (assq 'b '((a 1) (b 2))))
+(display (assv 2 '((1 one) (2 two))))
+(display (assoc "b" '(("a" . 1) ("b" . 2))))
+(display (assoc '(k) '(((k) . v))))
+(display (assq 'z '((a 1))))
+(display (assq 'a '()))
+(display "\n")
+; map and fold run in constant stack on a long list
+(define long (vector->list (make-vector 200000 1)))
+(display (length (map (lambda (x) (+ x 1)) long)))
+(display " ")
+(display (fold + 0 (map (lambda (x) (+ x 1)) long)))
+(display " ")
+(display (fold-right + 0 long))
+(display " ")
+(display (length (filter odd? long)))
+(display "\n")
+; vector-copy! within one vector, to either side, keeps the moved objects
+(define v (vector "a" "b" (list 1 2) "d" "e" "f"))
+(vector-copy! v 2 v 0 3)
+(display v)
+(vector-copy! v 0 v 2)
+(display v)
+(vector-copy! v 3 v 3)
+(display v)
+(display "\n")
+(vector-copy! v 4 v 0 3)
+(vector-copy! v 7 v)
+(vector-copy! v 0 v 4 2)
+; vector-fill! over a range
+(define v (make-vector 6 0))
+(vector-fill! v 'x 2 4)
+(display v)
+(vector-fill! v (list 'y) 4)
+(display v)
+(vector-fill! v 'z 3 3)
+(display v)
+(display "\n")
+(vector-fill! v 'x 4 2)
+(vector-fill! v 'x 0 7)
+; vector-grow keeps the elements and leaves the new slots unspecified
+(define g (vector-grow (vector 1 (list 2) "3") 5))
+(display (vector-length g))
+(display (vector-ref g 1))
+(display (vector-ref g 2))
+(vector-set! g 4 'end)
+(display (vector-ref g 4))
+(display (vector-length (vector-grow (vector) 0)))
+(display "\n")
+(vector-grow (vector 1 2) 1)
+(vector-grow '(1 2) 3)
+; vector-map and vector-for-each stop at the end of the shortest vector
+(display (vector-map + #(1 2 3) #(10 20) #(100 200 300)))
+(display (vector-map + #() #(1 2)))
+(display (vector-map (lambda (x) (* x x)) #(1 2 3)))
+(vector-for-each (lambda (x y) (display (list x y))) #(a b c) #(1 2))
+(display "\n")
+(vector-map + #(1) '(1))
+; appending in place to a shared buffer leaves the other strings alone
+(define s (string-copy "abc"))
+(define t (string-append s "def"))
+(define u (string-append s "xyz"))
+(string-set! t 0 #\T)
+(string-set! s 1 #\B)
+(display (list s t u (string-append s s) (string-append "" s "")))
+(display "\n")
+; long parts, ropes and a substring of the result as the next base
+(define long (make-string 300 #\-))
+(define r (string-append (substring long 0 299) long "!"))
+(define w (string-append (substring r 0 2) r (string-append r "?")))
+(display (list (string-length r) (string-length w)
+                (substring w 0 4) (substring w 600 602)
+                (substring w (- (string-length w) 3) (string-length w))))
+(display "\n")
+(define (accumulate n s)
+  (if (= n 0) s (accumulate (- n 1) (string-append s (number->string n) long))))
+(define acc (accumulate 2000 ""))
+(display (list (string-length acc) (substring acc 0 5)
+                (substring acc (- (string-length acc) 302)
+                                (- (string-length acc) 299))))
+(display (string-length (apply string-append (vector->list (make-vector 50000 long)))))
+(display "\n")
+(string-append "a" 'b)
+; string ports: write and display, string builders with mixed objects
+(define p (open-output-string))
+(write "a\"b" p)
+(display "a\"b" p)
+(write #\x p)
+(display #\x p)
+(write '(1 "s" #\c 2.5 sym) p)
+(newline p)
+(write-string "tail" p)
+(write-char #\! p)
+(write (get-output-string p))
+(display (get-output-string p))
+(display (string-length (get-output-string (open-output-string))))
+(display "\n")
+(define b (string-builder))
+(string-builder-append! b "str" #\c 42 'sym '(1 "x") (vector #\y) 1.5)
+(string-builder-append! b)
+(write (string-builder->string b))
+(define big (string-builder))
+(define (fill n)
+  (if (> n 0) ((lambda () (string-builder-append! big n #\,) (fill (- n 1))))))
+(fill 10000)
+(display (string-length (string-builder->string big)))
+(display "\n")
+; a closed string port keeps its text but takes no more output
+(close-output-port p)
+(close-output-port p)
+(write 1 p)
+(display "x" p)
+(write-char #\y p)
+(string-builder-append! p "z")
+(newline p)
+(display (string-length (get-output-string p)))
+(display "\n")
+(string-builder-append! 'p "z")
+; string search against a plain scan, with matches placed across the 16-
+; and 32-byte block edges and at the very end
+(define (naive pat str i)
+  (if (> (+ i (string-length pat)) (string-length str)) #f
+      (if (string=? pat (substring str i (+ i (string-length pat)))) i
+          (naive pat str (+ i 1)))))
+(define (check-at pat len pos bad)
+  (if (> (+ pos (string-length pat)) len) bad
+      ((lambda (str)
+         (check-at pat len (+ pos 1)
+                   (if (and (eqv? (string-search-forward pat str 0)
+                                  (naive pat str 0))
+                            (eqv? (string-contains str pat)
+                                  (naive pat str 0))
+                            (eqv? (string-index str (string-ref pat 0))
+                                  (naive (substring pat 0 1) str 0)))
+                       bad
+                       (cons (list pat len pos) bad))))
+       (string-append (make-string pos #\.) pat
+                      (make-string (- len pos (string-length pat)) #\.)))))
+(define (check-lens pat len bad)
+  (if (> len 70) bad
+      (check-lens pat (+ len 1) (check-at pat len 0 bad))))
+(define (check-pats pats bad)
+  (if (null? pats) bad
+      (check-pats (cdr pats) (check-lens (car pats) 1 bad))))
+(display (check-pats '("x" "xy" "x.x" "xyzxyzxyzxyzxyz" "xyzxyzxyzxyzxyzx"
+                        "xyzxyzxyzxyzxyzxy" "x..............................x"
+                        "x...............................x") '()))
+(display (string-search-forward "ab" (string-append (make-string 31 #\a) "b") 0))
+(display (string-search-forward "b" (string-append (make-string 63 #\a) "b") 0))
+(display (string-search-forward "ab" (make-string 64 #\a) 0))
+(display (string-search-forward "aab" "aaab" 2))
+(display (string-search-forward "" "abc" 3))
+(display (string-contains "abcabc" "abc" 1 5))
+(display (string-contains "abcabc" "abc" 1 6))
+(display (string-index "abcabc" #\c 3))
+(display "\n")
+(string-search-forward "a" "abc" 4)
+; string-split keeps the empty parts around leading, trailing and
+; adjacent delimiters
+(write (string-split ",a,,b," #\,))
+(write (string-split "a" #\,))
+(write (string-split "" #\,))
+(write (string-split ",," #\,))
+(write (string-split "--a----b--" "--"))
+(write (string-split "a---b" "--"))
+(write (string-split (string-append (make-string 40 #\x) ";" (make-string 20 #\y)) ";"))
+(display "\n")
+(string-split "abc" "")
+; string->number takes only the digits of the radix
+(display (list (string->number "1 0" 16) (string->number " 10" 16)
+               (string->number "10 " 16) (string->number "ff" 16)
+               (string->number "-FF" 16) (string->number "+101" 2)
+               (string->number "102" 2) (string->number "78" 8)
+               (string->number "g" 16) (string->number "" 16)
+               (string->number "-" 16) (string->number "1_0" 8)
+               (string->number "123456789abcdef0123456789" 16)))
+(display (list (string->number "1 0") (string->number "1e2")
+               (string->number "")))
+(display "\n")
+; records: constructors over a subset of the fields or none, accessors on
+; other types, bad definitions and records referring to themselves
+(define-record-type point (make-point y x) point? (x point-x set-point-x!)
+  (y point-y) (tag point-tag set-point-tag!))
+(define p (make-point 1 2))
+(display (list (point-x p) (point-y p) (point? p) (point? 5)))
+(set-point-tag! p 'origin)
+(set-point-x! p 10)
+(display (list (point-x p) (point-tag p)))
+(display "\n")
+(make-point 1)
+(make-point 1 2 3)
+(define-record-type hidden #f hidden? (secret hidden-secret))
+(display (list hidden? (hidden? p)))
+(display "\n")
+(make-hidden 1)
+(define-record-type other (make-other x) other? (x other-x))
+(point-x (make-other 1))
+(point-x 5)
+(set-point-x! (make-other 1) 2)
+(point-x)
+(define-record-type dup (make-dup a) dup? (a dup-a) (a dup-a2))
+(define-record-type badctor (make-badctor a a) badctor? (a badctor-a))
+(define-record-type badctor2 (make-badctor2 b) badctor2? (a badctor2-a))
+(define-record-type badfield (make-badfield a) badfield? (a get-a set-a! extra))
+(define-record-type node (make-node val next) node? (val node-val)
+  (next node-next set-node-next!))
+(define n (make-node 1 #f))
+(set-node-next! n n)
+(display (list (node-val (node-next (node-next n))) (eq? (node-next n) n)))
+(define m (make-node 2 n))
+(set-node-next! n m)
+(display (node-val (node-next (node-next (node-next n)))))
+(display "\n")
@@ -0,0 +1,47 @@
+; Loops that must run in constant space. gc-status counts the live objects.
+
+(display "Test tail calls: \n")
+; the body of `count-down` is a single invocation (of `if`)
+(define (count-down n)
+  (if (= n 0) (gc-status) (count-down (- n 1))))
+(define base (gc-status))
+(display (< (- (count-down 100000) base) 1000))
+; the body is a single call to another procedure
+(define (ping n) (if (= n 0) (gc-status) (pong (- n 1))))
+(define (pong n) (ping n))
+(display (< (- (ping 100000) base) 1000))
+(display "\n")
+
+(display "Test large live sets: \n")
+(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))
+; more containers than the initial work queues hold are scanned by the
+; cycle resolver
+(define big (build 270000 '()))
+(display (> (- (gc-status) base) 270000))
+(set-gc-resolve-threshold! 0)
+(display (car big))
+(set-gc-resolve-threshold! 131072)
+; and then freed at once
+(set! big '())
+(display (< (- (gc-status) base) 1000))
+(display "\n")
+
+(display "Test lists built by list: \n")
+(define base (gc-status))
+(define (make-lists n)
+  (if (= n 0) (gc-status) (and (list n n) (make-lists (- n 1)))))
+(display (< (- (make-lists 10000) base) 1000))
+(display (< (- (gc-status) base) 1000))
+(display "\n")
+
+(display "Test self-referencing records: \n")
+(define-record-type node (make-node next) node? (next node-next set-node-next!))
+(define base (gc-status))
+(define (make-cycles n)
+  (if (= n 0) (gc-status)
+      ((lambda (x) (set-node-next! x x) (make-cycles (- n 1))) (make-node #f))))
+(make-cycles 20000)
+(set-gc-resolve-threshold! 0)
+(display (< (- (gc-status) base) 1000))
+(set-gc-resolve-threshold! 131072)
+(display "\n")
@@ -6,8 +6,11 @@
 
 #include <cmath>
 #include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
 #include <sstream>
-#include <iomanip>
 
 const double EPS = 1e-16;
 const int PREC = 16;
@@ -45,6 +48,9 @@ ReprCons *Pair::get_repr_cons() {
 SymObj::SymObj(const string &str) :
 EvalObj(CLS_SIM_OBJ | CLS_SYM_OBJ), val(str) {}
 
+SymObj::SymObj(const char *str, size_t len) :
+EvalObj(CLS_SIM_OBJ | CLS_SYM_OBJ), val(str, len) {}
+
 ReprCons *SymObj::get_repr_cons() {
     return new ReprStr(val);
 }
@@ -126,12 +132,22 @@ Pair *ProcObj::call(Pair *_args, Environment * &lenvt,
         else if (args->cdr != empty_list || ppar != empty_list)
             throw TokenError("", RUN_ERR_WRONG_NUM_OF_ARGS);
 
-        gc.attach(static_cast<EvalObj*>(*(++top_ptr)));
-        top_ptr++;
-        cont->state = body;
+        // tail recursion opt, when the body is a single invocation
+        if (body->cdr == empty_list && !body->car->is_simple_obj())
+        {
+            cont->tail = true;
+            cont->state = NULL;
+            top_ptr++;                          // revert the cont
+        }
+        else
+        {
+            gc.attach(static_cast<EvalObj*>(*(++top_ptr)));
+            top_ptr++;
+            cont->state = body;
+        }
         gc.expose(_args);
         // Move pc to the proc entry point
-        return cont->state;
+        return body;
     }
 }
 
@@ -151,7 +167,10 @@ ReprCons *ProcObj::get_repr_cons() {
     return new ReprStr("#<Procedure>");
 }
 
-SpecialOptObj::SpecialOptObj(string _name) : OptObj(), name(_name) {}
+SpecialOptObj::SpecialOptObj(string _name) :
+OptObj(CLS_SPECIAL_OBJ), name(_name) {}
+
+const string &SpecialOptObj::get_name() { return name; }
 ReprCons *SpecialOptObj::get_repr_cons() {
     return new ReprStr("#<Built-in Opt: " + name + ">");
 }
@@ -179,10 +198,155 @@ EvalObj(CLS_SIM_OBJ | CLS_NUM_OBJ), exactness(_exactness), level(_level) {}
 
 bool NumObj::is_exact() { return exactness; }
 
-StrObj::StrObj(string _str) : EvalObj(CLS_SIM_OBJ | CLS_STR_OBJ), str(_str) {}
+/** Make a view of `len` characters from `off` in `buff` */
+static StrNodePtr str_view(const std::shared_ptr<string> &buff,
+                            size_t off, size_t len) {
+    StrNodePtr res = std::make_shared<StrNode>();
+    res->len = len;
+    res->depth = 0;
+    res->buff = buff;
+    res->off = off;
+    return res;
+}
+
+/** Append the characters of `node` to `buff` */
+static void str_append_to(string &buff, StrNode *node) {
+    std::vector<StrNode*> stack(1, node);
+    while (!stack.empty())
+    {
+        StrNode *top = stack.back();
+        stack.pop_back();
+        if (top->depth)
+        {
+            stack.push_back(top->right.get());
+            stack.push_back(top->left.get());
+        }
+        else if (top->buff.get() == &buff)
+            buff.append(string(buff, top->off, top->len));
+        else
+            buff.append(*top->buff, top->off, top->len);
+    }
+}
+
+/** Turn a rope into a view of a new buffer, in place, so all strings
+ * sharing the node see the result */
+static void str_flatten(StrNode *node) {
+    if (!node->depth) return;
+    std::shared_ptr<string> buff = std::make_shared<string>();
+    buff->reserve(node->len);
+    str_append_to(*buff, node);
+    node->buff = buff;
+    node->off = 0;
+    node->depth = 0;
+    node->left.reset();
+    node->right.reset();
+}
+
+/** Test if nothing views the buffer of `node` beyond its end, so
+ * characters can be appended to the buffer in place */
+static bool str_appendable(const StrNodePtr &node) {
+    return !node->depth && node->off + node->len == node->buff->length();
+}
+
+/** Concatenate `a` and `b`. Any string is appended to the end of a buffer
+ * not used beyond the view, so repeatedly appending to a string takes
+ * amortized linear time. Otherwise short strings are copied, and only long
+ * ones make rope nodes */
+static StrNodePtr str_join(const StrNodePtr &a, const StrNodePtr &b) {
+    if (!a->len) return b;
+    if (!b->len) return a;
+    if (str_appendable(a))
+    {
+        str_append_to(*a->buff, b.get());
+        return str_view(a->buff, a->off, a->len + b->len);
+    }
+    if (!b->depth && b->len < STR_FLAT_LIMIT)
+    {
+        if (!a->depth)
+        {
+            if (a->len < STR_FLAT_LIMIT)
+            {
+                std::shared_ptr<string> buff = std::make_shared<string>();
+                buff->reserve(a->len + b->len);
+                buff->append(*a->buff, a->off, a->len);
+                buff->append(*b->buff, b->off, b->len);
+                return str_view(buff, 0, buff->length());
+            }
+        }
+        else if (!a->right->depth)
+            return str_join(a->left, str_join(a->right, b));
+    }
+    else if (!a->depth && a->len < STR_FLAT_LIMIT &&
+            b->depth && !b->left->depth && b->left->len < STR_FLAT_LIMIT)
+        return str_join(str_join(a, b->left), b->right);
+    StrNodePtr res = std::make_shared<StrNode>();
+    res->len = a->len + b->len;
+    res->depth = std::max(a->depth, b->depth) + 1;
+    res->left = a;
+    res->right = b;
+    if (res->depth > STR_ROPE_DEPTH)
+        str_flatten(res.get());
+    return res;
+}
+
+StrObj::StrObj(string _str) : EvalObj(CLS_SIM_OBJ | CLS_STR_OBJ) {
+    size_t len = _str.length();
+    node = str_view(std::make_shared<string>(std::move(_str)), 0, len);
+}
+
+StrObj::StrObj(StrObj *src, size_t st, size_t ed) :
+EvalObj(CLS_SIM_OBJ | CLS_STR_OBJ) {
+    src->flatten();
+    node = str_view(src->node->buff, src->node->off + st, ed - st);
+}
+
+StrObj::StrObj(StrObj *a, StrObj *b) :
+EvalObj(CLS_SIM_OBJ | CLS_STR_OBJ), node(str_join(a->node, b->node)) {}
+
+void StrObj::flatten() { str_flatten(node.get()); }
+
+void StrObj::reserve(size_t len) {
+    flatten();
+    if (str_appendable(node))
+        node->buff->reserve(node->off + len);
+    else
+    {
+        std::shared_ptr<string> buff = std::make_shared<string>();
+        buff->reserve(len);
+        buff->append(*node->buff, node->off, node->len);
+        node = str_view(buff, 0, node->len);
+    }
+}
+
+void StrObj::unshare() {
+    flatten();
+    if (node.use_count() > 1 || node->buff.use_count() > 1 ||
+            node->len != node->buff->length())
+        node = str_view(std::make_shared<string>(data(), node->len),
+                        0, node->len);
+}
+
+size_t StrObj::length() { return node->len; }
+
+const char *StrObj::data() {
+    flatten();
+    return node->buff->data() + node->off;
+}
+
+string StrObj::get_str() { return string(data(), node->len); }
+
+void StrObj::set(size_t idx, char ch) {
+    unshare();
+    (*node->buff)[idx] = ch;
+}
+
+void StrObj::fill(char ch, size_t st, size_t ed) {
+    unshare();
+    node->buff->replace(st, ed - st, ed - st, ch);
+}
 
 ReprCons *StrObj::get_repr_cons() {
-    return new ReprStr(str);
+    return new ReprStr(get_str());
 }
 
 CharObj::CharObj(char _ch) : EvalObj(CLS_SIM_OBJ | CLS_CHAR_OBJ), ch(_ch) {}
@@ -276,28 +440,40 @@ StrObj *StrObj::from_string(string repr) {
     return NULL;
 }
 
+int StrObj::compare(StrObj *r) {
+    if (node == r->node) return 0;
+    size_t len = std::min(length(), r->length());
+    int res = len ? memcmp(data(), r->data(), len) : 0;
+    if (res) return res;
+    return length() < r->length() ? -1 : length() > r->length();
+}
+
 bool StrObj::lt(StrObj *r) {
-    return str < r->str;
+    return compare(r) < 0;
 }
 
 bool StrObj::gt(StrObj *r) {
-    return str > r->str;
+    return compare(r) > 0;
 }
 
 bool StrObj::le(StrObj *r) {
-    return str <= r->str;
+    return compare(r) <= 0;
 }
 
 bool StrObj::ge(StrObj *r) {
-    return str >= r->str;
+    return compare(r) >= 0;
 }
 
 bool StrObj::eq(StrObj *r) {
-    return str == r->str;
+    // strings of different lengths differ without looking at them
+    if (length() != r->length()) return false;
+    return node == r->node || !memcmp(data(), r->data(), length());
 }
 
 BuiltinProcObj::BuiltinProcObj(BuiltinProc f, string _name) :
-OptObj(), handler(f), name(_name) {}
+OptObj(CLS_BUILTIN_OBJ), handler(f), name(_name) {}
+
+const string &BuiltinProcObj::get_name() { return name; }
 
 Pair *BuiltinProcObj::call(Pair *args, Environment * &lenvt,
         Continuation * &cont, EvalObj ** &top_ptr, Pair *pc) {
@@ -314,7 +490,7 @@ ReprCons *BuiltinProcObj::get_repr_cons() {
 }
 
 Environment::Environment(Environment *_prev_envt) : 
-Container(), prev_envt(_prev_envt) {
+Container(CLS_ENVT_OBJ), prev_envt(_prev_envt) {
     gc.attach(prev_envt);
 }
 
@@ -395,6 +571,16 @@ EvalObj *Environment::get_obj(EvalObj *obj) {
     throw TokenError(name, RUN_ERR_UNBOUND_VAR);
 }
 
+Environment *Environment::get_prev() { return prev_envt; }
+
+void Environment::set_prev(Environment *_prev_envt) {
+    gc.expose(prev_envt);
+    prev_envt = _prev_envt;
+    gc.attach(prev_envt);
+}
+
+const Str2EvalObj &Environment::get_bindings() { return binding; }
+
 Continuation::Continuation(Environment *_envt, Pair *_pc, 
         Continuation *_prev_cont ) :
 Container(), prev_cont(_prev_cont), envt(_envt), pc(_pc), 
@@ -424,7 +610,7 @@ ReprCons *Continuation::get_repr_cons() {
 
 ReprCons::ReprCons(bool _prim, EvalObj *_ori) : ori(_ori), prim(_prim) {}
 ReprStr::ReprStr(string _repr) : ReprCons(true) { repr = _repr; }
-EvalObj *ReprStr::next(const string &prev) {
+EvalObj *ReprStr::next(OutputSink &out, ReprPath &path) {
     fprintf(stderr, "Oops in ReprStr::next\n");
     throw NormalError(INT_ERR);
 }
@@ -432,58 +618,68 @@ EvalObj *ReprStr::next(const string &prev) {
 PairReprCons::PairReprCons(Pair *_ptr, EvalObj *_ori) :
 ReprCons(false, _ori), state(0), ptr(_ptr) {}
 
-EvalObj *PairReprCons::next(const string &prev) {
-    repr += prev;
-    EvalObj *res;
+void PairReprCons::leave(ReprPath &path) {
+    // `ori` itself is removed by `write_repr`
+    for (EvalObj *p = ori; p != ptr; )
+    {
+        p = TO_PAIR(p)->cdr;
+        path.erase(p);
+    }
+}
+
+EvalObj *PairReprCons::next(OutputSink &out, ReprPath &path) {
     if (state == 0)
     {
         state = 1;
-        res = TO_PAIR(ptr)->car;
-        if (res->is_pair_obj())
-            repr += "(";
-        return res;
+        out.put('(');
+        return TO_PAIR(ptr)->car;
     }
     else if (state == 1)
     {
-        state = 2;
-        if (TO_PAIR(ptr)->car->is_pair_obj())
-            repr += ")";
-        ptr = TO_PAIR(ptr)->cdr;
-        if (ptr == empty_list)
+        EvalObj *cdr = TO_PAIR(ptr)->cdr;
+        if (cdr == empty_list)
+        {
+            out.put(')');
+            leave(path);
             return NULL;
-        repr += " ";
-        if (ptr->is_simple_obj())
-            repr += ". ";
-        return ptr;
+        }
+        if (cdr->is_pair_obj())
+        {
+            if (path.count(cdr))
+            {
+                out.write(" #inf#)", 7);
+                leave(path);
+                return NULL;
+            }
+            // continue with the spine in the same frame
+            path.insert(ptr = cdr);
+            out.put(' ');
+            return TO_PAIR(ptr)->car;
+        }
+        state = 2;
+        out.write(" . ", 3);
+        return cdr;
     }
     else
     {
+        out.put(')');
+        leave(path);
         return NULL;
     }
 }
 
 VectReprCons::VectReprCons(VecObj *_ptr, EvalObj *_ori) :
-ReprCons(false, _ori), ptr(_ptr), idx(0) { repr = "#("; }
-
-EvalObj *VectReprCons::next(const string &prev) {
-    repr += prev;
-
-    if (idx && ptr->get(idx - 1)->is_pair_obj())
-        repr += ")";
+ReprCons(false, _ori), ptr(_ptr), idx(0) {}
 
+EvalObj *VectReprCons::next(OutputSink &out, ReprPath &path) {
+    if (!idx) out.write("#(", 2);
     if (idx == ptr->get_size())
     {
-        repr += ")";
+        out.put(')');
         return NULL;
     }
-    else
-    {
-        if (idx) repr += " ";
-        EvalObj *res = ptr->get(idx++);
-        if (res->is_pair_obj())
-            repr += "(";
-        return res;
-    }
+    if (idx) out.put(' ');
+    return ptr->get(idx++);
 }
 
 PromObj::PromObj(EvalObj *_exp) :
@@ -519,12 +715,47 @@ void PromObj::feed_mem(EvalObj *res) {
 }
 
 
-string double_to_str(double val, bool force_sign = false) {
-    std::stringstream ss;
-    if (force_sign) ss << std::showpos;
-    ss << std::setprecision(PREC);
-    ss << val;
-    return ss.str();
+string double_to_str(double val, bool force_sign) {
+    if (std::isnan(val)) return "+nan.0";
+    if (std::isinf(val)) return val > 0 ? "+inf.0" : "-inf.0";
+    char buff[40], *ptr = buff, *last = buff + sizeof(buff);
+    if (force_sign && !std::signbit(val)) *ptr++ = '+';
+    // the shortest digits that read back as `val`, in the fixed notation
+    // for moderate exponents and the scientific one otherwise, as `%g`
+    // with PREC digits lays them out
+    char *end = std::to_chars(ptr, last, val,
+                                std::chars_format::scientific).ptr;
+    const char *epos = static_cast<const char*>(memchr(ptr, 'e', end - ptr));
+    int exp = 0;
+    std::from_chars(epos + (epos[1] == '+' ? 2 : 1), end, exp);
+    if (-4 <= exp && exp < PREC)
+    {
+        end = std::to_chars(ptr, last, val, std::chars_format::fixed).ptr;
+        // keep integral values inexact when read back
+        if (!memchr(ptr, '.', end - ptr))
+        {
+            *end++ = '.';
+            *end++ = '0';
+        }
+    }
+    return string(buff, end);
+}
+
+double num_to_double(NumObj *num) {
+    switch (num->level)
+    {
+        case NUM_LVL_REAL: return static_cast<RealNumObj*>(num)->real;
+#ifdef GMP_SUPPORT
+        case NUM_LVL_RAT: return static_cast<RatNumObj*>(num)->val.get_d();
+        case NUM_LVL_INT: return static_cast<IntNumObj*>(num)->val.get_d();
+#else
+        case NUM_LVL_RAT:
+            return static_cast<RatNumObj*>(num)->a /
+                    double(static_cast<RatNumObj*>(num)->b);
+        case NUM_LVL_INT: return static_cast<IntNumObj*>(num)->val;
+#endif
+    }
+    throw TokenError("a real number", RUN_ERR_WRONG_TYPE);
 }
 
 string int_to_str(int val) {
@@ -533,17 +764,27 @@ string int_to_str(int val) {
     return ss.str();
 }
 
-double str_to_double(string repr, bool &flag) {
-    const char *nptr = repr.c_str();
-    char *endptr;
-    double val = strtod(nptr, &endptr);
-    if (endptr == nptr || endptr != nptr + repr.length())
+double str_to_double(const char *str, size_t len, bool &flag) {
+    const char *end = str + len, *ptr = str;
+    bool neg = false;
+    double val;
+    flag = false;
+    if (ptr != end && (*ptr == '+' || *ptr == '-')) neg = *ptr++ == '-';
+    if (ptr != str && end - ptr == 5 &&
+            (!memcmp(ptr, "inf.0", 5) || !memcmp(ptr, "nan.0", 5)))
+        val = *ptr == 'i' ? HUGE_VAL : NAN;
+    else
     {
-        flag = false;
-        return 0;
+        // only the decimal notation, without the words `inf` and `nan`
+        if (ptr == end || !(isdigit(*ptr) || *ptr == '.')) return 0;
+        std::from_chars_result fr = std::from_chars(ptr, end, val);
+        if (fr.ptr != end) return 0;
+        if (fr.ec == std::errc::result_out_of_range)
+            val = strtod(string(ptr, end).c_str(), NULL);
+        else if (fr.ec != std::errc()) return 0;
     }
     flag = true;
-    return val;
+    return neg ? -val : val;
 }
 
 int str_to_int(string repr, bool &flag) {
@@ -754,7 +995,7 @@ NumObj *RealNumObj::clone() const {
 
 RealNumObj *RealNumObj::from_string(string repr) {
     bool flag;
-    double real = str_to_double(repr, flag);
+    double real = str_to_double(repr.data(), repr.length(), flag);
     if (!flag) return NULL;
     return new RealNumObj(real);
 }
@@ -8,6 +8,7 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <memory>
 #include <gmpxx.h>
 
 using std::string;
@@ -23,6 +24,8 @@ const int CLS_VECT_OBJ = 1 << 8;
 const int CLS_OPT_OBJ = 1 << 3;
 const int CLS_CONT_OBJ = 1 << 9;
 const int CLS_ENVT_OBJ = 1 << 10;
+const int CLS_SPECIAL_OBJ = 1 << 14;
+const int CLS_BUILTIN_OBJ = 1 << 15;
 
 static const int NUM_LVL_COMP = 0;
 static const int NUM_LVL_REAL = 1;
@@ -64,21 +67,23 @@ class EmptyList: public Pair {/*{{{*/
 
 /** @class ReprCons
  * The abstraction class to represent a representation construction, which is
- * used as stack frame in `ext_repr`.
+ * used as stack frame in `write_repr`.
  */
 class ReprCons {/*{{{*/
     public:
         EvalObj *ori;           /**< Reflexive pointer to the obj */
         bool prim;             /**< true if no further expansion is needed */
-        /** The finally generated external represenation of the EvalObj */
+        /** The external represenation of a primitive EvalObj */
         string repr;
         /** The constructor */
         ReprCons(bool prim, EvalObj *ori = NULL);
-        ~ReprCons() {}
-        /** This function is called to get the next component in a complex
-         * EvalObj
-         * @param prev Feed the string form of the previous component */
-        virtual EvalObj *next(const string &prev) = 0;
+        virtual ~ReprCons() {}
+        /** This function is called to write the next part of a complex
+         * EvalObj to `out`
+         * @param path The objects being written (including `ori`)
+         * @return The next component to be written, NULL if the object is
+         * finished */
+        virtual EvalObj *next(OutputSink &out, ReprPath &path) = 0;
 };/*}}}*/
 
 /** @class ReprStr
@@ -88,20 +93,23 @@ class ReprStr : public ReprCons {/*{{{*/
     public:
         /** The constructor */
         ReprStr(string repr);
-        EvalObj *next(const string &prev);
+        EvalObj *next(OutputSink &out, ReprPath &path);
 };/*}}}*/
 
 /** @class PairReprCons
- * The ReprCons implementation of Pair
+ * The ReprCons implementation of Pair, which walks through the whole list
+ * spine in a single frame
  */
 class PairReprCons : public ReprCons {/*{{{*/
     private:
         int state;
         EvalObj *ptr;
+        /** Remove the spine pairs visited by this frame from `path` */
+        void leave(ReprPath &path);
     public:
         /** The constructor */
         PairReprCons(Pair *ptr, EvalObj *ori);
-        EvalObj *next(const string &prev);
+        EvalObj *next(OutputSink &out, ReprPath &path);
 };/*}}}*/
 
 class VecObj;
@@ -116,7 +124,7 @@ class VectReprCons : public ReprCons {/*{{{*/
     public:
         /** The constructor */
         VectReprCons(VecObj *ptr, EvalObj *ori);
-        EvalObj *next(const string &prev);
+        EvalObj *next(OutputSink &out, ReprPath &path);
 };/*}}}*/
 
 
@@ -138,6 +146,8 @@ class SymObj: public EvalObj {/*{{{*/
         string val;
         /** The constructor */
         SymObj(const string &);
+        /** Construct from a part of a buffer */
+        SymObj(const char *str, size_t len);
         ReprCons *get_repr_cons();
 };/*}}}*/
 
@@ -201,6 +211,8 @@ class SpecialOptObj: public OptObj {/*{{{*/
     public:
         /** The constructor */
         SpecialOptObj(string name);
+        /** Get the name of this operator */
+        const string &get_name();
         ReprCons *get_repr_cons();
 };/*}}}*/
 
@@ -219,6 +231,8 @@ class BuiltinProcObj: public OptObj {/*{{{*/
          * @param name the name of this built-in procedure
          */
         BuiltinProcObj(BuiltinProc proc, string name);
+        /** Get the name of this built-in procedure */
+        const string &get_name();
         Pair *call(Pair *args, Environment * &envt,
                     Continuation * &cont, EvalObj ** &top_ptr, Pair *pc);
         ReprCons *get_repr_cons();
@@ -275,21 +289,69 @@ class NumObj: public EvalObj {/*{{{*/
         virtual bool eq(NumObj *r) = 0;     /**< "=" implementation of numbers */
 };/*}}}*/
 
+/** The number of characters below which a concatenation is copied instead
+ * of being kept as a rope node */
+const size_t STR_FLAT_LIMIT = 256;
+/** The deepest rope kept before it is flattened */
+const int STR_ROPE_DEPTH = 48;
+
+/** @class StrNode
+ * The storage of strings: either a view of a buffer shared by many strings,
+ * or the concatenation of two nodes, which is flattened into a view when
+ * the characters are needed
+ */
+struct StrNode {
+    size_t len;                         /**< The number of characters */
+    int depth;                          /**< 0 for a view */
+    std::shared_ptr<string> buff;       /**< The buffer of a view */
+    size_t off;                         /**< The start of a view */
+    std::shared_ptr<StrNode> left;      /**< The first part of a rope */
+    std::shared_ptr<StrNode> right;     /**< The second part of a rope */
+};
+
+typedef std::shared_ptr<StrNode> StrNodePtr;
+
 /** @class StrObj
  * String support
  */
 class StrObj: public EvalObj {/*{{{*/
+    private:
+        /** Storage implementation: a view or a rope */
+        StrNodePtr node;
+        /** Make the characters contiguous */
+        void flatten();
+        /** Make the buffer used by this string only, before changing it */
+        void unshare();
     public:
-        /** Storage implementation: C++ string */
-        string str;
-
         /** Construct a string object */
         StrObj(string str);
+        /** Construct the substring [st, ed) of `src`, sharing its buffer */
+        StrObj(StrObj *src, size_t st, size_t ed);
+        /** Construct the concatenation of `a` and `b` */
+        StrObj(StrObj *a, StrObj *b);
+        /** Make room for `len` characters in total, so that appending up
+         * to that length copies each character once */
+        void reserve(size_t len);
         /** Try to construct an StrObj object
          * @return NULL if failed
          */
         static StrObj *from_string(string repr);
 
+        /** Get the number of characters */
+        size_t length();
+        /** Get the characters, which are not terminated by NUL and stay
+         * valid until the next change of any string */
+        const char *data();
+        /** Get a copy of the characters */
+        string get_str();
+        /** Replace the character at `idx` */
+        void set(size_t idx, char ch);
+        /** Replace the characters in [st, ed) with `ch` */
+        void fill(char ch, size_t st, size_t ed);
+
+        /** Compare the characters as unsigned bytes
+         * @return negative, zero or positive as `memcmp` */
+        int compare(StrObj *r);
         bool lt(StrObj *r);     /**< "<" implementation of strings */
         bool gt(StrObj *r);     /**< ">" implementation of strings */
         bool le(StrObj *r);     /**< "<=" implementation of strings */
@@ -397,6 +459,12 @@ class Environment : public Container{/*{{{*/
          * @param obj the object as request
          * */
         EvalObj *get_obj(EvalObj *obj);
+        /** Get the outer environment */
+        Environment *get_prev();
+        /** Replace the outer environment */
+        void set_prev(Environment *prev_envt);
+        /** Get all bindings of this environment */
+        const Str2EvalObj &get_bindings();
         ReprCons *get_repr_cons();
 
         void gc_decrement();
@@ -602,4 +670,12 @@ class IntNumObj: public ExactNumObj {/*{{{*/
 };/*}}}*/
 
 bool is_zero(double);
+/** Get the external representation of an inexact real number */
+string double_to_str(double val, bool force_sign = false);
+/** Parse the flonum in the `len` characters at `str`, including `+inf.0`,
+ * `-inf.0` and `+nan.0`
+ * @param flag set to false if it is not a flonum */
+double str_to_double(const char *str, size_t len, bool &flag);
+/** Convert a real number to a double, throwing if it is complex */
+double num_to_double(NumObj *num);
 #endif